@@ -0,0 +1,517 @@
+// This file is part of BetterMultiSelection.
+// 
+// Copyright (C)2017 Justin Dailey <dail8859@yahoo.com>
+// 
+// BetterMultiSelection is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#if defined(SCALAR_ONLY)
+// Built without SIMD for the benchmarks to compare against
+#elif defined(_M_IX86) || defined(_M_X64)
+#include <intrin.h>
+#include <tmmintrin.h>
+#define WORD_SCAN_SSSE3
+#elif defined(__SSSE3__)
+#include <tmmintrin.h>
+#define WORD_SCAN_SSSE3
+#endif
+
+#include "CaretMovement.h"
+#include "UniConversion.h"
+
+CharacterClassifier::CharacterClassifier() {
+	memset(classes, ccUnknown, sizeof(classes));
+	memset(nibbleBits, 0, sizeof(nibbleBits));
+	for (int ch = 0; ch < 256; ch++) {
+		nibbleBits[ccUnknown][ch >> 7][ch & 0xF] |= 1 << ((ch >> 4) & 0x7);
+	}
+
+	// Mirrors Scintilla's CharClassify::SetDefaultCharClasses()
+	for (int ch = 0; ch < 256; ch++) {
+		if (ch == '\r' || ch == '\n')
+			SetClass(static_cast<unsigned char>(ch), ccNewLine);
+		else if (ch < 0x20 || ch == ' ')
+			SetClass(static_cast<unsigned char>(ch), ccSpace);
+		else if (ch >= 0x80 || isalnum(ch) || ch == '_')
+			SetClass(static_cast<unsigned char>(ch), ccWord);
+		else
+			SetClass(static_cast<unsigned char>(ch), ccPunctuation);
+	}
+}
+
+void CharacterClassifier::SetClass(unsigned char ch, CharacterClass newClass) {
+	const unsigned char bit = static_cast<unsigned char>(1 << ((ch >> 4) & 0x7));
+
+	nibbleBits[classes[ch]][ch >> 7][ch & 0xF] &= ~bit;
+	nibbleBits[newClass][ch >> 7][ch & 0xF] |= bit;
+	classes[ch] = newClass;
+}
+
+void CharacterClassifier::SetCharClasses(const char *chars, int length, CharacterClass newClass) {
+	for (int i = 0; i < length; i++) {
+		SetClass(static_cast<unsigned char>(chars[i]), newClass);
+	}
+}
+
+// In UTF-8 Scintilla classifies non-ASCII characters by their Unicode category
+void CharacterClassifier::SetUnknownAbove(unsigned char ch) {
+	for (int i = ch + 1; i < 256; i++) {
+		SetClass(static_cast<unsigned char>(i), ccUnknown);
+	}
+}
+
+#ifdef WORD_SCAN_SSSE3
+
+#ifdef _MSC_VER
+#define NOINLINE __declspec(noinline)
+
+static bool HasSSSE3() {
+	static const bool hasSSSE3 = [] {
+		int info[4];
+		__cpuid(info, 1);
+		return (info[2] & (1 << 9)) != 0;
+	}();
+	return hasSSSE3;
+}
+
+static unsigned long LowestBit(unsigned long mask) {
+	unsigned long index;
+	_BitScanForward(&index, mask);
+	return index;
+}
+
+static unsigned long HighestBit(unsigned long mask) {
+	unsigned long index;
+	_BitScanReverse(&index, mask);
+	return index;
+}
+#else
+#define NOINLINE __attribute__((noinline))
+
+// Only built with SSSE3 when the compiler was told it can use it everywhere
+static bool HasSSSE3() {
+	return true;
+}
+
+static unsigned long LowestBit(unsigned long mask) {
+	return static_cast<unsigned long>(__builtin_ctzl(mask));
+}
+
+static unsigned long HighestBit(unsigned long mask) {
+	return static_cast<unsigned long>(sizeof(mask) * 8 - 1 - __builtin_clzl(mask));
+}
+#endif
+
+// Returns a 16 bit mask of which bytes are in the class. Each byte is split into
+// nibbles, the low nibble looks up a row of bits and the high nibble picks the bit.
+static int ClassMask(__m128i bytes, __m128i lowTable, __m128i highTable) {
+	const __m128i nibbleMask = _mm_set1_epi8(0x0F);
+	const __m128i bitTable = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+
+	const __m128i lowNibbles = _mm_and_si128(bytes, nibbleMask);
+	const __m128i highNibbles = _mm_and_si128(_mm_srli_epi16(bytes, 4), nibbleMask);
+
+	const __m128i lowRows = _mm_shuffle_epi8(lowTable, lowNibbles);
+	const __m128i highRows = _mm_shuffle_epi8(highTable, lowNibbles);
+	const __m128i isHigh = _mm_cmpgt_epi8(highNibbles, _mm_set1_epi8(7));
+	const __m128i rows = _mm_or_si128(_mm_and_si128(isHigh, highRows), _mm_andnot_si128(isHigh, lowRows));
+
+	const __m128i bits = _mm_shuffle_epi8(bitTable, highNibbles);
+	return _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(rows, bits), bits));
+}
+
+// Most words are only a few bytes long, and checking those one at a time is
+// quicker than setting up the tables, so SSSE3 only takes over after this many
+static const Sci_Position scalarScan = 16;
+
+// The first position from pos on that is not in the class, 16 bytes at a time
+// until there are fewer than that left. Kept out of line so the short scans
+// that never get here stay small enough to inline.
+NOINLINE static Sci_Position ScanForward(const char *text, Sci_Position start, Sci_Position end, const CharacterClassifier *classifier, Sci_Position pos, CharacterClass cc) {
+	const __m128i lowTable = _mm_loadu_si128(reinterpret_cast<const __m128i *>(classifier->NibbleBits(cc, 0)));
+	const __m128i highTable = _mm_loadu_si128(reinterpret_cast<const __m128i *>(classifier->NibbleBits(cc, 1)));
+
+	while (pos >= start && end - pos >= 16) {
+		const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(text + (pos - start)));
+		const unsigned long others = ~ClassMask(bytes, lowTable, highTable) & 0xFFFF;
+		if (others != 0) {
+			return pos + static_cast<Sci_Position>(LowestBit(others));
+		}
+		pos += 16;
+	}
+	return pos;
+}
+
+// The same going back, where the character before each position is checked
+NOINLINE static Sci_Position ScanBackward(const char *text, Sci_Position start, Sci_Position end, const CharacterClassifier *classifier, Sci_Position pos, CharacterClass cc) {
+	const __m128i lowTable = _mm_loadu_si128(reinterpret_cast<const __m128i *>(classifier->NibbleBits(cc, 0)));
+	const __m128i highTable = _mm_loadu_si128(reinterpret_cast<const __m128i *>(classifier->NibbleBits(cc, 1)));
+
+	while (pos <= end && pos - start >= 16) {
+		const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(text + (pos - start - 16)));
+		const unsigned long others = ~ClassMask(bytes, lowTable, highTable) & 0xFFFF;
+		if (others != 0) {
+			return pos - 16 + static_cast<Sci_Position>(HighestBit(others)) + 1;
+		}
+		pos -= 16;
+	}
+	return pos;
+}
+
+#endif
+
+// Returns the first position at or after pos that is not in the class, or the
+// end of the snapshot
+Sci_Position DocumentSnapshot::SkipForward(Sci_Position pos, CharacterClass cc) const {
+#ifdef WORD_SCAN_SSSE3
+	const Sci_Position from = pos;
+#endif
+	while (Contains(pos) && classifier->GetClass(UCharAt(pos)) == cc) {
+		pos++;
+#ifdef WORD_SCAN_SSSE3
+		if (pos - from == scalarScan && HasSSSE3())
+			pos = ScanForward(text, start, end, classifier, pos, cc);
+#endif
+	}
+	return pos;
+}
+
+// Returns the first position at or before pos where the character before it is
+// not in the class, or the start of the snapshot
+Sci_Position DocumentSnapshot::SkipBackward(Sci_Position pos, CharacterClass cc) const {
+#ifdef WORD_SCAN_SSSE3
+	const Sci_Position from = pos;
+#endif
+	while (Contains(pos - 1) && classifier->GetClass(UCharAt(pos - 1)) == cc) {
+		pos--;
+#ifdef WORD_SCAN_SSSE3
+		if (from - pos == scalarScan && HasSSSE3())
+			pos = ScanBackward(text, start, end, classifier, pos, cc);
+#endif
+	}
+	return pos;
+}
+
+// Decoding a UTF-8 character can look at a few bytes either side of pos
+bool DocumentSnapshot::HasCharacterAround(Sci_Position pos) const {
+	const Sci_Position needStart = pos - UTF8MaxBytes - 1 > 0 ? pos - UTF8MaxBytes - 1 : 0;
+	const Sci_Position needEnd = pos + UTF8MaxBytes < length ? pos + UTF8MaxBytes : length;
+	return needStart >= start && needEnd <= end;
+}
+
+// Same as Scintilla's Document::InGoodUTF8()
+bool DocumentSnapshot::InGoodUTF8(Sci_Position pos, Sci_Position &startUTF, Sci_Position &endUTF) const {
+	Sci_Position trail = pos;
+	while ((trail > 0) && (pos - trail < UTF8MaxBytes) && UTF8IsTrailByte(UCharAt(trail - 1)))
+		trail--;
+	startUTF = (trail > 0) ? trail - 1 : trail;
+
+	const unsigned char leadByte = UCharAt(startUTF);
+	const int widthCharBytes = UTF8BytesOfLead[leadByte];
+	if (widthCharBytes == 1) {
+		return false;
+	}
+	else {
+		const int trailBytes = widthCharBytes - 1;
+		if (pos - startUTF > trailBytes) {
+			// pos too far from lead
+			return false;
+		}
+
+		unsigned char charBytes[UTF8MaxBytes] = { leadByte, 0, 0, 0 };
+		for (int b = 1; b < widthCharBytes && (startUTF + b) < length; b++)
+			charBytes[b] = UCharAt(startUTF + b);
+
+		if (UTF8Classify(charBytes, widthCharBytes) & UTF8MaskInvalid)
+			return false;
+
+		endUTF = startUTF + widthCharBytes;
+		return true;
+	}
+}
+
+// Same as Scintilla's Document::MovePositionOutsideChar() when checking line ends
+Sci_Position DocumentSnapshot::MovePositionOutsideChar(Sci_Position pos, int moveDir) const {
+	if (pos <= 0)
+		return 0;
+	if (pos >= length)
+		return length;
+
+	if (!HasCharacterAround(pos))
+		return invalidPosition;
+
+	if (UCharAt(pos - 1) == '\r' && UCharAt(pos) == '\n') {
+		return (moveDir > 0) ? pos + 1 : pos - 1;
+	}
+
+	if (utf8 && UTF8IsTrailByte(UCharAt(pos))) {
+		Sci_Position startUTF = pos;
+		Sci_Position endUTF = pos;
+		if (InGoodUTF8(pos, startUTF, endUTF)) {
+			// It is a trail byte within a UTF-8 character
+			pos = (moveDir > 0) ? endUTF : startUTF;
+		}
+		// Else invalid UTF-8 so return position of isolated trail byte
+	}
+
+	return pos;
+}
+
+CharacterClass DocumentSnapshot::ClassBefore(Sci_Position pos) const {
+	if (!Contains(pos - 1))
+		return ccUnknown;
+	return classifier->GetClass(UCharAt(pos - 1));
+}
+
+CharacterClass DocumentSnapshot::ClassAfter(Sci_Position pos) const {
+	if (!Contains(pos))
+		return ccUnknown;
+	return classifier->GetClass(UCharAt(pos));
+}
+
+Sci_Position DocumentSnapshot::PositionBefore(Sci_Position pos) const {
+	return MovePositionOutsideChar(pos - 1, -1);
+}
+
+Sci_Position DocumentSnapshot::PositionAfter(Sci_Position pos) const {
+	return MovePositionOutsideChar(pos + 1, 1);
+}
+
+// Same as Scintilla's Document::NextWordStart(). Runs of the same class are
+// skipped a block at a time, if a run stops on a character that can't be
+// classified the position is unknown.
+Sci_Position DocumentSnapshot::NextWordStart(Sci_Position pos, int delta) const {
+	if (delta < 0) {
+		pos = SkipBackward(pos, ccSpace);
+		if (pos > 0) {
+			const CharacterClass ccStart = ClassBefore(pos);
+			if (ccStart == ccUnknown)
+				return invalidPosition;
+			pos = SkipBackward(pos, ccStart);
+			if (pos > 0 && ClassBefore(pos) == ccUnknown)
+				return invalidPosition;
+		}
+	}
+	else {
+		if (pos < length) {
+			const CharacterClass ccStart = ClassAfter(pos);
+			if (ccStart == ccUnknown)
+				return invalidPosition;
+			pos = SkipForward(pos, ccStart);
+			if (pos < length && ClassAfter(pos) == ccUnknown)
+				return invalidPosition;
+		}
+		pos = SkipForward(pos, ccSpace);
+		if (pos < length && ClassAfter(pos) == ccUnknown)
+			return invalidPosition;
+	}
+	return pos;
+}
+
+// Same as Scintilla's Document::NextWordEnd()
+Sci_Position DocumentSnapshot::NextWordEnd(Sci_Position pos, int delta) const {
+	if (delta < 0) {
+		if (pos > 0) {
+			const CharacterClass ccStart = ClassBefore(pos);
+			if (ccStart == ccUnknown)
+				return invalidPosition;
+			if (ccStart != ccSpace)
+				pos = SkipBackward(pos, ccStart);
+			pos = SkipBackward(pos, ccSpace);
+			if (pos > 0 && ClassBefore(pos) == ccUnknown)
+				return invalidPosition;
+		}
+	}
+	else {
+		pos = SkipForward(pos, ccSpace);
+		if (pos < length) {
+			const CharacterClass ccStart = ClassAfter(pos);
+			if (ccStart == ccUnknown)
+				return invalidPosition;
+			pos = SkipForward(pos, ccStart);
+			if (pos < length && ClassAfter(pos) == ccUnknown)
+				return invalidPosition;
+		}
+	}
+	return pos;
+}
+
+Sci_Position DocumentSnapshot::LineStartPosition(Sci_Position pos) const {
+	while (pos > 0) {
+		if (!Contains(pos - 1))
+			return invalidPosition;
+		const unsigned char ch = UCharAt(pos - 1);
+		if (ch == '\r' || ch == '\n')
+			break;
+		pos--;
+	}
+	return pos;
+}
+
+Sci_Position DocumentSnapshot::LineEndPosition(Sci_Position pos) const {
+	while (pos < length) {
+		if (!Contains(pos))
+			return invalidPosition;
+		const unsigned char ch = UCharAt(pos);
+		if (ch == '\r' || ch == '\n')
+			break;
+		pos++;
+	}
+	return pos;
+}
+
+// Same as Scintilla's Document::VCHomePosition()
+Sci_Position DocumentSnapshot::VCHomePosition(Sci_Position pos) const {
+	const Sci_Position startPosition = LineStartPosition(pos);
+	if (startPosition == invalidPosition)
+		return invalidPosition;
+
+	Sci_Position startText = startPosition;
+	while (startText < length) {
+		if (!Contains(startText))
+			return invalidPosition;
+		const unsigned char ch = UCharAt(startText);
+		if (ch != ' ' && ch != '\t')
+			break;
+		startText++;
+	}
+
+	return (pos == startText) ? startPosition : startText;
+}
+
+// Record where each line inside the snapshot starts. The snapshot is expected to
+// start at the beginning of a line.
+void DocumentSnapshot::IndexLines(std::vector<Sci_Position> &buffer) {
+	lineStarts = &buffer;
+
+	buffer.clear();
+	buffer.push_back(start);
+
+	for (Sci_Position pos = start; pos < end; pos++) {
+		const unsigned char ch = UCharAt(pos);
+		if (ch == '\r' && pos + 1 < end && UCharAt(pos + 1) == '\n') {
+			pos++;
+			buffer.push_back(pos + 1);
+		}
+		else if (ch == '\r' || ch == '\n') {
+			buffer.push_back(pos + 1);
+		}
+	}
+}
+
+// Index into lineStarts of the line containing pos, or -1
+Sci_Position DocumentSnapshot::LineIndex(Sci_Position pos) const {
+	if (pos < start || pos > end)
+		return -1;
+
+	const auto it = std::upper_bound(lineStarts->cbegin(), lineStarts->cend(), pos);
+	return (it - lineStarts->cbegin()) - 1;
+}
+
+static Sci_Position NextTab(Sci_Position column, int tabWidth) {
+	return ((column / tabWidth) + 1) * tabWidth;
+}
+
+// Scintilla moves carets up and down by their pixel position, not by column.
+// The two only line up when every character is one cell of a fixed width font.
+// Wide or combining characters and control characters (drawn as blobs) don't.
+static bool IsSingleCell(unsigned char ch) {
+	return ch >= 0x20 && ch < 0x7F;
+}
+
+// Same as Scintilla's Document::GetColumn(), but only for text that is all
+// single cell characters or tabs before pos
+Sci_Position DocumentSnapshot::Column(Sci_Position pos, int tabWidth) const {
+	const Sci_Position line = LineIndex(pos);
+	if (line < 0)
+		return invalidPosition;
+
+	Sci_Position column = 0;
+	for (Sci_Position i = (*lineStarts)[line]; i < pos;) {
+		const unsigned char ch = UCharAt(i);
+		if (ch == '\t') {
+			column = NextTab(column, tabWidth);
+			i++;
+		}
+		else if (ch == '\r' || ch == '\n') {
+			return column;
+		}
+		else if (IsSingleCell(ch)) {
+			column++;
+			i++;
+		}
+		else {
+			return invalidPosition;
+		}
+	}
+
+	return column;
+}
+
+// Same as Scintilla's Document::FindColumn(), but only for text that is all
+// single cell characters or tabs up to the column
+Sci_Position DocumentSnapshot::FindColumn(Sci_Position lineStart, Sci_Position column, int tabWidth) const {
+	Sci_Position position = lineStart;
+	Sci_Position columnCurrent = 0;
+
+	while ((columnCurrent < column) && (position < length)) {
+		if (!Contains(position))
+			return invalidPosition;
+
+		const unsigned char ch = UCharAt(position);
+		if (ch == '\t') {
+			columnCurrent = NextTab(columnCurrent, tabWidth);
+			if (columnCurrent > column)
+				return position;
+			position++;
+		}
+		else if (ch == '\r' || ch == '\n') {
+			return position;
+		}
+		else if (IsSingleCell(ch)) {
+			columnCurrent++;
+			position++;
+		}
+		else {
+			return invalidPosition;
+		}
+	}
+
+	return position;
+}
+
+// Where the caret at pos ends up when moving to the previous or next line while
+// trying to stay in the given column
+Sci_Position DocumentSnapshot::PositionUpOrDown(Sci_Position pos, int direction, Sci_Position column, int tabWidth) const {
+	const Sci_Position line = LineIndex(pos);
+	if (line < 0)
+		return invalidPosition;
+
+	// Scintilla knows best what happens past the first or last line
+	const Sci_Position targetLine = line + direction;
+	if (targetLine < 0 || targetLine >= static_cast<Sci_Position>(lineStarts->size()))
+		return invalidPosition;
+
+	const Sci_Position targetStart = (*lineStarts)[targetLine];
+	if (targetStart == end && end < length)
+		return invalidPosition;
+
+	return FindColumn(targetStart, column, tabWidth);
+}
@@ -0,0 +1,111 @@
+// This file is part of BetterMultiSelection.
+// 
+// Copyright (C)2017 Justin Dailey <dail8859@yahoo.com>
+// 
+// BetterMultiSelection is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "Sci_Position.h"
+
+// Same classes Scintilla uses to decide where words start and end
+enum CharacterClass : unsigned char {
+	ccSpace,
+	ccNewLine,
+	ccWord,
+	ccPunctuation,
+	ccUnknown // Can't be decided from a single byte
+};
+
+class CharacterClassifier final {
+private:
+	unsigned char classes[256];
+
+	// For each class, indexed by the low nibble of a byte, the bits of which high
+	// nibbles (0-7 and 8-15) are in that class. Lets 16 bytes get classified at once.
+	unsigned char nibbleBits[ccUnknown + 1][2][16];
+
+	void SetClass(unsigned char ch, CharacterClass newClass);
+
+public:
+	CharacterClassifier();
+
+	void SetCharClasses(const char *chars, int length, CharacterClass newClass);
+	void SetUnknownAbove(unsigned char ch);
+
+	CharacterClass GetClass(unsigned char ch) const {
+		return static_cast<CharacterClass>(classes[ch]);
+	}
+
+	const unsigned char *NibbleBits(CharacterClass cc, int highHalf) const {
+		return nibbleBits[cc][highHalf];
+	}
+};
+
+// A read only view of the document text from start to end, as handed out by
+// SCI_GETRANGEPOINTER. The positions calculated match what Scintilla would do
+// for the same movement. When the answer depends on text outside of the view
+// (or on something only Scintilla knows) invalidPosition is returned instead.
+class DocumentSnapshot final {
+private:
+	const char *text;
+	Sci_Position start;
+	Sci_Position end;
+	Sci_Position length;
+	bool utf8;
+	const CharacterClassifier *classifier;
+	const std::vector<Sci_Position> *lineStarts = nullptr;
+
+	bool Contains(Sci_Position pos) const {
+		return pos >= start && pos < end;
+	}
+
+	unsigned char UCharAt(Sci_Position pos) const {
+		return static_cast<unsigned char>(text[pos - start]);
+	}
+
+	bool HasCharacterAround(Sci_Position pos) const;
+	bool InGoodUTF8(Sci_Position pos, Sci_Position &startUTF, Sci_Position &endUTF) const;
+	Sci_Position MovePositionOutsideChar(Sci_Position pos, int moveDir) const;
+	Sci_Position LineIndex(Sci_Position pos) const;
+	Sci_Position FindColumn(Sci_Position lineStart, Sci_Position column, int tabWidth) const;
+	CharacterClass ClassBefore(Sci_Position pos) const;
+	CharacterClass ClassAfter(Sci_Position pos) const;
+	Sci_Position SkipForward(Sci_Position pos, CharacterClass cc) const;
+	Sci_Position SkipBackward(Sci_Position pos, CharacterClass cc) const;
+
+public:
+	static const Sci_Position invalidPosition = -1;
+
+	DocumentSnapshot(const char *text, Sci_Position start, Sci_Position end, Sci_Position length, bool utf8, const CharacterClassifier *classifier = nullptr)
+		: text(text), start(start), end(end), length(length), utf8(utf8), classifier(classifier) {}
+
+	Sci_Position PositionBefore(Sci_Position pos) const;
+	Sci_Position PositionAfter(Sci_Position pos) const;
+	Sci_Position NextWordStart(Sci_Position pos, int delta) const;
+	Sci_Position NextWordEnd(Sci_Position pos, int delta) const;
+	Sci_Position LineStartPosition(Sci_Position pos) const;
+	Sci_Position LineEndPosition(Sci_Position pos) const;
+	Sci_Position VCHomePosition(Sci_Position pos) const;
+
+	// Column and PositionUpOrDown need the lines to be indexed first. The line
+	// starts are kept in the given buffer, which has to outlive the snapshot.
+	void IndexLines(std::vector<Sci_Position> &buffer);
+	Sci_Position Column(Sci_Position pos, int tabWidth) const;
+	Sci_Position PositionUpOrDown(Sci_Position pos, int direction, Sci_Position column, int tabWidth) const;
+};
@@ -0,0 +1,91 @@
+// This file is part of BetterMultiSelection.
+// 
+// Copyright (C)2017 Justin Dailey <dail8859@yahoo.com>
+// 
+// BetterMultiSelection is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+
+#include "CaretSet.h"
+
+// Signed values are zigzag encoded so small negative numbers stay small, then
+// written 7 bits at a time with the high bit set on all but the last byte
+void CaretSet::Write(std::vector<unsigned char> &bytes, Sci_Position value) {
+	size_t zigzag = (static_cast<size_t>(value) << 1) ^ static_cast<size_t>(value >> (sizeof(Sci_Position) * 8 - 1));
+	while (zigzag >= 0x80) {
+		bytes.push_back(static_cast<unsigned char>(zigzag | 0x80));
+		zigzag >>= 7;
+	}
+	bytes.push_back(static_cast<unsigned char>(zigzag));
+}
+
+Sci_Position CaretSet::Read(const unsigned char *&p) {
+	size_t zigzag = 0;
+	int shift = 0;
+	while (*p & 0x80) {
+		zigzag |= static_cast<size_t>(*p++ & 0x7F) << shift;
+		shift += 7;
+	}
+	zigzag |= static_cast<size_t>(*p++) << shift;
+
+	return static_cast<Sci_Position>(zigzag >> 1) ^ -static_cast<Sci_Position>(zigzag & 1);
+}
+
+void CaretSet::Assign(const std::vector<Selection> &selections) {
+	bytes.clear();
+	count = selections.size();
+
+	Sci_Position previous = 0;
+	size_t i = 0;
+	while (i < selections.size()) {
+		const Sci_Position stride = selections[i].caret - previous;
+		const Sci_Position width = selections[i].anchor - selections[i].caret;
+
+		// Extend the run while the selections keep the same spacing and size
+		size_t next = i + 1;
+		while (next < selections.size() && selections[next].caret - selections[next - 1].caret == stride && selections[next].anchor - selections[next].caret == width)
+			++next;
+
+		Write(bytes, static_cast<Sci_Position>(next - i));
+		Write(bytes, stride);
+		Write(bytes, width);
+
+		previous = selections[next - 1].caret;
+		i = next;
+	}
+
+	// Keep the memory for next time unless it is mostly going to waste
+	if (bytes.capacity() > 4 * bytes.size() + 4096)
+		bytes.shrink_to_fit();
+}
+
+void CaretSet::CopyTo(std::vector<Selection> &selections) const {
+	selections.clear();
+
+	ForEach([&selections](const Selection &selection) {
+		selections.push_back(selection);
+		return true;
+	});
+}
+
+bool CaretSet::Equals(const std::vector<Selection> &selections) const {
+	if (selections.size() != count)
+		return false;
+
+	size_t i = 0;
+	return ForEach([&](const Selection &selection) {
+		const Selection &other = selections[i++];
+		return other.caret == selection.caret && other.anchor == selection.anchor;
+	});
+}
@@ -0,0 +1,72 @@
+// This file is part of BetterMultiSelection.
+// 
+// Copyright (C)2017 Justin Dailey <dail8859@yahoo.com>
+// 
+// BetterMultiSelection is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "SelectionSet.h"
+
+// A compact copy of lots of selections, for keeping them around between key
+// presses. Selections that are the same distance apart and the same size (e.g.
+// the same column on lines of equal length) are stored as a single run, and
+// every number is stored as a variable length difference so everything else
+// still only takes a few bytes per selection.
+class CaretSet final {
+private:
+	std::vector<unsigned char> bytes;
+	size_t count = 0;
+
+	static void Write(std::vector<unsigned char> &bytes, Sci_Position value);
+	static Sci_Position Read(const unsigned char *&p);
+
+public:
+	void Assign(const std::vector<Selection> &selections);
+	void CopyTo(std::vector<Selection> &selections) const;
+	bool Equals(const std::vector<Selection> &selections) const;
+
+	void clear() { bytes.clear(); count = 0; }
+	size_t size() const { return count; }
+	bool empty() const { return count == 0; }
+	size_t MemoryUsed() const { return bytes.capacity(); }
+
+	// Calls f with each selection in order until it returns false. Returns
+	// whether every selection was visited.
+	template<typename F>
+	bool ForEach(F f) const {
+		const unsigned char *p = bytes.data();
+		const unsigned char *end = p + bytes.size();
+
+		Sci_Position caret = 0;
+		while (p < end) {
+			const Sci_Position runLength = Read(p);
+			const Sci_Position stride = Read(p);
+			const Sci_Position width = Read(p);
+
+			for (Sci_Position i = 0; i < runLength; ++i) {
+				caret += stride;
+				if (!f(Selection(caret, caret + width)))
+					return false;
+			}
+		}
+
+		return true;
+	}
+};
@@ -0,0 +1,139 @@
+// This file is part of BetterMultiSelection.
+// 
+// Copyright (C)2017 Justin Dailey <dail8859@yahoo.com>
+// 
+// BetterMultiSelection is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+#pragma once
+
+#include <string>
+
+#include "Scintilla.h"
+
+// Other plugins can do a lot of work for every SCN_MODIFIED they see, which adds
+// up when one key press edits thousands of carets. If enabled, the insertion and
+// deletion notifications are masked off while a batch is applied. Each change
+// made is recorded with Add so the region they all fall in is known. Afterwards
+// the new text of that region is reported as inserted, followed by the old text
+// being deleted right after it. That way the inserted text is in place while its
+// notification is handled, and the document is exactly as reported once the
+// deletion is. The BEFORE notifications can't be sent after the fact so they
+// are simply skipped.
+//
+// The old text is gone by then, so it has to be kept with KeepOriginal before
+// anything changes. If a change turns out to reach outside of what was kept the
+// deletion is not reported at all, rather than reported without its text.
+//
+// Scintilla sends the notifications to its parent window, so that is left to
+// notify, which gets everything but the header filled in.
+template<typename Editor>
+class CoalescedModifications final {
+public:
+	typedef void (*NotifyFunction)(SCNotification &scn);
+
+private:
+	static const int textModifications = SC_MOD_INSERTTEXT | SC_MOD_DELETETEXT | SC_MOD_BEFOREINSERT | SC_MOD_BEFOREDELETE | SC_PERFORMED_USER | SC_STARTACTION;
+
+	// Reused so a key press doesn't allocate once it has grown
+	static std::string original;
+
+	Editor &editor;
+	NotifyFunction notify;
+	bool active;
+	int eventMask;
+	Sci_Position lengthBefore;
+	Sci_Position linesBefore;
+	Sci_Position originalStart = -1;
+
+	// Where the changes so far are, in positions of the document as it is now
+	Sci_Position start = -1;
+	Sci_Position end = -1;
+
+	void Notify(int modificationType, Sci_Position position, Sci_Position length, const char *text, Sci_Position linesAdded) const {
+		SCNotification scn = {};
+		scn.nmhdr.code = SCN_MODIFIED;
+		scn.modificationType = modificationType | SC_PERFORMED_USER;
+		scn.position = position;
+		scn.length = length;
+		scn.text = text;
+		scn.linesAdded = linesAdded;
+		notify(scn);
+	}
+
+public:
+	CoalescedModifications(Editor &editor, bool active, NotifyFunction notify) : editor(editor), notify(notify), active(active) {
+		if (!active)
+			return;
+
+		eventMask = editor.GetModEventMask();
+		lengthBefore = editor.GetLength();
+		linesBefore = editor.GetLineCount();
+		editor.SetModEventMask(eventMask & ~textModifications);
+	}
+
+	bool Active() const {
+		return active;
+	}
+
+	// Copies the text from keepStart to keepEnd, where the changes are going to
+	// be made, while it is still there
+	void KeepOriginal(Sci_Position keepStart, Sci_Position keepEnd) {
+		if (!active)
+			return;
+
+		original.assign(editor.GetRangePointer(keepStart, keepEnd - keepStart), keepEnd - keepStart);
+		originalStart = keepStart;
+	}
+
+	// The text from changeStart to changeEnd, in positions from before the
+	// change, was replaced with text that is delta bytes longer
+	void Add(Sci_Position changeStart, Sci_Position changeEnd, Sci_Position delta) {
+		if (start < 0) {
+			start = changeStart;
+			end = changeEnd + delta;
+			return;
+		}
+
+		end = (changeEnd <= end) ? end + delta : changeEnd + delta;
+		start = (changeStart < start) ? changeStart : start;
+	}
+
+	~CoalescedModifications() {
+		if (active) {
+			editor.SetModEventMask(eventMask);
+		}
+
+		if (active && start >= 0) {
+			const Sci_Position insertedLength = end - start;
+			const Sci_Position deletedLength = insertedLength - (editor.GetLength() - lengthBefore);
+			const Sci_Position linesInserted = editor.LineFromPosition(end) - editor.LineFromPosition(start);
+			const Sci_Position linesDeleted = linesInserted - (editor.GetLineCount() - linesBefore);
+
+			// Nothing before the changes has moved, so start is where the old text started too
+			const bool kept = originalStart >= 0 && start >= originalStart && start + deletedLength <= originalStart + static_cast<Sci_Position>(original.size());
+
+			if ((eventMask & SC_MOD_INSERTTEXT) && insertedLength > 0)
+				Notify(SC_MOD_INSERTTEXT, start, insertedLength, editor.GetRangePointer(start, insertedLength), linesInserted);
+			if ((eventMask & SC_MOD_DELETETEXT) && deletedLength > 0 && kept)
+				Notify(SC_MOD_DELETETEXT, end, deletedLength, original.data() + (start - originalStart), -linesDeleted);
+		}
+	}
+
+	CoalescedModifications(const CoalescedModifications &) = delete;
+	CoalescedModifications &operator=(const CoalescedModifications &) = delete;
+};
+
+template<typename Editor>
+std::string CoalescedModifications<Editor>::original;
@@ -0,0 +1,35 @@
+// This file is part of BetterMultiSelection.
+// 
+// Copyright (C)2017 Justin Dailey <dail8859@yahoo.com>
+// 
+// BetterMultiSelection is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+
+#include "CostModel.h"
+
+Strategy ChooseStrategy(const Costs &costs, const std::vector<Selection> &selections, bool modifiesDocument, int steps) {
+	Sci_Position minCaret = selections.front().caret;
+	Sci_Position maxCaret = selections.front().caret;
+	for (const auto &selection : selections) {
+		minCaret = (selection.caret < minCaret) ? selection.caret : minCaret;
+		maxCaret = (selection.caret > maxCaret) ? selection.caret : maxCaret;
+	}
+
+	const long long runs = static_cast<long long>(selections.size()) * (steps > 1 ? steps : 1);
+	const long long eachSelection = runs * (modifiesDocument ? costs.edit : costs.move);
+	const long long batch = costs.batch + (maxCaret - minCaret) + runs * costs.caret;
+
+	return (batch < eachSelection) ? Strategy::Batch : Strategy::EachSelection;
+}
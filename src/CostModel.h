@@ -0,0 +1,47 @@
+// This file is part of BetterMultiSelection.
+// 
+// Copyright (C)2017 Justin Dailey <dail8859@yahoo.com>
+// 
+// BetterMultiSelection is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+
+#pragma once
+
+#include <vector>
+
+#include "SelectionSet.h"
+
+// How a command gets applied to every selection
+enum class Strategy {
+	EachSelection, // Scintilla runs the command once per selection
+	Batch          // The plugin works out all the results from a snapshot of the text
+};
+
+// Rough estimates in units of reading one byte of the document, which is what a
+// batch spends on the text between the first and last caret. Having Scintilla
+// run a command for a selection means selecting it, sending the command and
+// reading the selection back (move), and an edit also adds an undo step and
+// notifications (edit). A batch has a fixed cost to set up (batch) and works
+// out each selection itself (caret). The defaults come from CostCalibration.
+struct Costs {
+	int move = 1500;
+	int edit = 6000;
+	int batch = 1200;
+	int caret = 110;
+};
+
+// Compares what running the command steps times for every selection would cost
+// each way
+Strategy ChooseStrategy(const Costs &costs, const std::vector<Selection> &selections, bool modifiesDocument, int steps);
@@ -19,14 +19,27 @@
 #include "AboutDialog.h"
 #include "resource.h"
 #include "PluginInterface.h"
-#include "ScintillaEditor.h"
+#include "PositionEditor.h"
+#include "CaretMovement.h"
+#include "CaretSet.h"
+#include "CoalescedModifications.h"
+#include "CostModel.h"
+#include "SelectionEdit.h"
+#include "SelectionSet.h"
+#include "ShadowSelections.h"
+#include "TextConversion.h"
 
 #include "UniConversion.h"
 #include "GlobalMemory.h"
 
 #include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <vector>
-#include <sstream>
+
 
 #define IsShiftPressed()   ((GetKeyState(VK_SHIFT) & KF_UP) != 0)
 #define IsControlPressed() ((GetKeyState(VK_CONTROL) & KF_UP) != 0)
@@ -37,7 +50,9 @@ static HANDLE _hModule;
 static NppData nppData;
 static HHOOK hook = NULL;
 static bool hasFocus = true;
-static ScintillaEditor editor;
+static bool coalesceModifications = false;
+static Costs costs;
+static PositionEditor editor;
 
 static UINT cfMultiSelect = 0;
 static UINT cfColumnSelect = 0;
@@ -47,19 +62,6 @@ static void showAbout();
 
 static LRESULT CALLBACK KeyboardProc(int ncode, WPARAM wparam, LPARAM lparam);
 
-struct Selection {
-	int caret;
-	int anchor;
-
-	Selection(int caret, int anchor) : caret(caret), anchor(anchor) {}
-
-	int start() const { return min(caret, anchor); }
-	int end() const { return max(caret, anchor); }
-	int length() const { return end() - start(); }
-	void set(int pos) { anchor = caret = pos; }
-	void offset(int offset) { anchor += offset; caret += offset; }
-};
-
 static FuncItem funcItem[] = {
 	{ TEXT("Enable"), enableBetterMultiSelection, 0, false, nullptr },
 	{ TEXT(""), nullptr, 0, false, nullptr },
@@ -77,6 +79,17 @@ static const wchar_t *GetIniFilePath() {
 	return iniPath;
 }
 
+static int ReadCost(const wchar_t *key, int defaultCost) {
+	const int cost = static_cast<int>(GetPrivateProfileInt(TEXT("BetterMultiSelection"), key, defaultCost, GetIniFilePath()));
+	return max(cost, 0);
+}
+
+static void WriteCost(const wchar_t *key, int cost) {
+	wchar_t value[16];
+	swprintf_s(value, L"%d", cost);
+	WritePrivateProfileString(TEXT("BetterMultiSelection"), key, value, GetIniFilePath());
+}
+
 static void enableBetterMultiSelection() {
 	if (hook) {
 		UnhookWindowsHookEx(hook);
@@ -100,174 +113,596 @@ static HWND GetCurrentScintilla() {
 	return (which == 0) ? nppData._scintillaMainHandle : nppData._scintillaSecondHandle;
 }
 
-static std::vector<Selection> GetSelections() {
-	std::vector<Selection> selections;
+static bool IsOtherViewOfDocument(HWND hwnd) {
+	if (hwnd == editor.GetScintillaInstance() || (hwnd != nppData._scintillaMainHandle && hwnd != nppData._scintillaSecondHandle))
+		return false;
+
+	return SendMessage(hwnd, SCI_GETDOCPOINTER, 0, 0) == static_cast<LRESULT>(editor.GetDocPointer());
+}
+
+static void GetSelections(std::vector<Selection> &selections) {
+	selections.clear();
 
 	int num = editor.GetSelections();
 	for (int i = 0; i < num; ++i) {
-		int caret = editor.GetSelectionNCaret(i);
-		int anchor = editor.GetSelectionNAnchor(i);
+		Sci_Position caret = editor.GetSelectionNCaret(i);
+		Sci_Position anchor = editor.GetSelectionNAnchor(i);
 		selections.emplace_back(Selection{ caret, anchor });
 	}
-
-	return selections;
 }
 
-static void SetSelections(const std::vector<Selection> &selections) {
-	for (size_t i = 0; i < selections.size(); ++i) {
-		if (i == 0)
-			editor.SetSelection(selections[i].caret, selections[i].anchor);
-		else
-			editor.AddSelection(selections[i].caret, selections[i].anchor);
+// Holds off painting while lots of selections get edited one after another.
+// Each message sent for a caret can also scroll the view to it, so the scroll
+// position is put back when done and then only the main caret is scrolled to.
+// Nested instances leave it all to the outermost one.
+class FrozenView final {
+private:
+	static int depth;
+
+	Sci_Position firstVisibleLine;
+	int xOffset;
+
+public:
+	static bool Active() {
+		return depth > 0;
 	}
-}
 
-template<typename It>
-It uniquify(It begin, It const end)
-{
-	std::vector<It> v;
-	v.reserve(static_cast<size_t>(std::distance(begin, end)));
+	FrozenView() {
+		if (depth++ > 0)
+			return;
 
-	for (It i = begin; i != end; ++i)
-		v.push_back(i);
+		firstVisibleLine = editor.GetFirstVisibleLine();
+		xOffset = editor.GetXOffset();
+		SendMessage(editor.GetScintillaInstance(), WM_SETREDRAW, FALSE, 0);
+	}
 
-	std::sort(v.begin(), v.end(), [](const auto &lhs, const auto &rhs) {
-		return (*lhs).start() < (*rhs).start() || (!((*rhs).start() < (*lhs).start()) && (*lhs).end() < (*rhs).end());
-	});
+	~FrozenView() {
+		if (--depth > 0)
+			return;
 
-	v.erase(std::unique(v.begin(), v.end(), [](const auto &lhs, const auto &rhs) {
-		return (*lhs).start() == (*rhs).start() && (*lhs).end() == (*rhs).end();
-	}), v.end());
+		editor.SetFirstVisibleLine(firstVisibleLine);
+		editor.SetXOffset(xOffset);
+		editor.ScrollCaret();
 
-	std::sort(v.begin(), v.end());
+		SendMessage(editor.GetScintillaInstance(), WM_SETREDRAW, TRUE, 0);
+		RedrawWindow(editor.GetScintillaInstance(), NULL, NULL, RDW_INVALIDATE);
+	}
 
-	size_t j = 0;
-	for (It i = begin; i != end && j != v.size(); ++i) {
-		if (i == v[j]) {
-			using std::iter_swap; iter_swap(i, begin);
-			++j;
-			++begin;
-		}
+	FrozenView(const FrozenView &) = delete;
+	FrozenView &operator=(const FrozenView &) = delete;
+};
+
+int FrozenView::depth = 0;
+
+// The same way Scintilla notifies its parent
+static void NotifyParent(SCNotification &scn) {
+	HWND hwnd = editor.GetScintillaInstance();
+
+	scn.nmhdr.hwndFrom = hwnd;
+	scn.nmhdr.idFrom = GetDlgCtrlID(hwnd);
+	SendMessage(GetParent(hwnd), WM_NOTIFY, scn.nmhdr.idFrom, reinterpret_cast<LPARAM>(&scn));
+}
+
+// The selections as the plugin last saw them
+static ShadowSelections shadowSelections;
+
+// Reused for every key press so it only has to grow when there are more
+// selections than ever before
+static std::vector<Selection> keySelections;
+
+static std::vector<Selection> &CurrentSelections() {
+	if (shadowSelections.Matches(editor)) {
+#ifdef _DEBUG
+		if (!shadowSelections.Equals(editor))
+			OutputDebugStringA("BetterMultiSelection: shadow selections are out of sync with Scintilla\n");
+#endif
+		shadowSelections.CopyTo(keySelections);
+		return keySelections;
 	}
-	return begin;
+
+	GetSelections(keySelections);
+	shadowSelections.Set(keySelections);
+	return keySelections;
+}
+
+static void SetSelections(const std::vector<Selection> &selections) {
+	// Hold off painting until every selection has been set
+	FrozenView frozenView;
+
+	RestoreSelections(editor, selections);
+
+	shadowSelections.Set(selections);
 }
 
 // Create a closure that simply calls a SCI_XXX message
-static auto SimpleEdit(int message) {
-	return [message](Selection &selection) {
+static auto SimpleEdit(int message, int times = 1) {
+	return [message, times](Selection &selection) {
 		editor.SetSelection(selection.caret, selection.anchor);
-		editor.Call(message);
+		for (int i = 0; i < times; ++i)
+			editor.Call(message);
 
 		selection.caret = editor.GetSelectionNCaret(0);
 		selection.anchor = editor.GetSelectionNAnchor(0);
 	};
 }
 
+// ModifiesDocument is known at compile time so that pure cursor movements don't
+// pay for undo grouping or for tracking how the document length changes
+template<bool ModifiesDocument, typename T>
+static void EditSelections(std::vector<Selection> &selections, T edit) {
+	FrozenView frozenView;
+
+	editor.ClearSelections();
+
+	SortSelections(selections);
+
+	if (ModifiesDocument) {
+		CoalescedModifications<PositionEditor> coalesced(editor, coalesceModifications, NotifyParent);
+
+		// Whatever the edits change is assumed to be on the lines of the
+		// selections or the ones either side of them
+		if (coalesced.Active() && !selections.empty()) {
+			Sci_Position maxEnd = 0;
+			for (const auto &selection : selections)
+				maxEnd = max(maxEnd, selection.end());
+
+			const Sci_Position firstLine = editor.LineFromPosition(selections.front().start()) - 1;
+			const Sci_Position lastLine = editor.LineFromPosition(maxEnd) + 1;
+			const Sci_Position keepStart = editor.PositionFromLine(max(firstLine, 0));
+			const Sci_Position keepEnd = (lastLine + 1 < editor.GetLineCount()) ? editor.PositionFromLine(lastLine + 1) : editor.GetLength();
+			coalesced.KeepOriginal(keepStart, keepEnd);
+		}
+
+		editor.BeginUndoAction();
+
+		// The length after one edit is the length before the next one
+		Sci_Position totalOffset = 0;
+		Sci_Position length = editor.GetLength();
+		for (auto &selection : selections) {
+			selection.offset(totalOffset);
+			const Sci_Position start = selection.start();
+			const Sci_Position end = selection.end();
+
+			edit(selection);
+
+			const Sci_Position newLength = editor.GetLength();
+			const Sci_Position delta = newLength - length;
+			totalOffset += delta;
+			length = newLength;
+
+			if (coalesced.Active()) {
+				// Whatever an edit deletes is between where the selection was and
+				// where the caret ends up (e.g. backspace or deleting a word over
+				// blank lines). Anything else it does, such as auto-indent, is
+				// assumed to stay before the end of the caret's new line.
+				const Sci_Position changeStart = min(start, selection.start());
+				const Sci_Position lineEnd = editor.GetLineEndPosition(editor.LineFromPosition(selection.caret));
+				coalesced.Add(changeStart, max(max(end, changeStart - delta), lineEnd - delta), delta);
+			}
+		}
+
+		editor.EndUndoAction();
+	}
+	else {
+		// Nothing moves out from under the other selections
+		for (auto &selection : selections) {
+			edit(selection);
+		}
+	}
+
+	MergeSelections(selections);
+
+	SetSelections(selections);
+}
+
 template<typename T>
 static void EditSelections(T edit) {
-	auto selections = GetSelections();
+	EditSelections<true>(CurrentSelections(), edit);
+}
 
-	editor.ClearSelections();
+static bool IsWordMovement(int message) {
+	switch (message) {
+		case SCI_WORDLEFT:
+		case SCI_WORDLEFTEXTEND:
+		case SCI_WORDRIGHT:
+		case SCI_WORDRIGHTEXTEND:
+		case SCI_WORDRIGHTENDEXTEND:
+		case SCI_DELWORDLEFT:
+		case SCI_DELWORDRIGHT:
+			return true;
+	}
+	return false;
+}
 
-	std::sort(selections.begin(), selections.end(), [](const auto &lhs, const auto &rhs) {
-		return lhs.start() < rhs.start() || (!(rhs.start() < lhs.start()) && lhs.end() < rhs.end());
-	});
+// Whether every text style looks the same as STYLE_DEFAULT, as far as the width
+// of its characters goes
+static bool StyleLooksLikeDefault(int style, const char *defaultFont) {
+	char font[256];
+	if (editor.StyleGetFont(style, nullptr) >= static_cast<int>(sizeof(font)))
+		return false;
+	editor.StyleGetFont(style, font);
+
+	return strcmp(font, defaultFont) == 0 &&
+		editor.StyleGetSizeFractional(style) == editor.StyleGetSizeFractional(STYLE_DEFAULT) &&
+		editor.StyleGetWeight(style) == editor.StyleGetWeight(STYLE_DEFAULT) &&
+		editor.StyleGetItalic(style) == editor.StyleGetItalic(STYLE_DEFAULT);
+}
+
+// Scintilla keeps carets in the same pixel position when moving up and down
+// while the plugin keeps them in the same column, which is only the same thing
+// when every character is as wide as a space, in every style text can have.
+// Styles that are set up the same as STYLE_DEFAULT don't need measuring. The
+// line numbers, indent guides, call tips and the like are never in the text.
+static bool CheckFixedWidthFont() {
+	const int width = editor.TextWidth(STYLE_DEFAULT, " ");
+	if (editor.TextWidth(STYLE_DEFAULT, "i") != width || editor.TextWidth(STYLE_DEFAULT, "W") != width)
+		return false;
 
-	editor.BeginUndoAction();
+	char defaultFont[256];
+	if (editor.StyleGetFont(STYLE_DEFAULT, nullptr) >= static_cast<int>(sizeof(defaultFont)))
+		defaultFont[0] = '\0';
+	else
+		editor.StyleGetFont(STYLE_DEFAULT, defaultFont);
 
-	int totalOffset = 0;
-	for (auto &selection : selections) {
-		selection.offset(totalOffset);
-		const int length = editor.GetLength();
+	for (int style = 0; style <= STYLE_MAX; ++style) {
+		if (style == STYLE_DEFAULT || style == STYLE_LINENUMBER || (style > STYLE_BRACEBAD && style <= STYLE_LASTPREDEFINED))
+			continue;
 
-		edit(selection);
+		if (StyleLooksLikeDefault(style, defaultFont))
+			continue;
 
-		totalOffset += editor.GetLength() - length;
+		if (editor.TextWidth(style, " ") != width || editor.TextWidth(style, "i") != width || editor.TextWidth(style, "W") != width)
+			return false;
 	}
+	return true;
+}
 
-	editor.EndUndoAction();
+// Checking every style takes about a thousand messages, so the answer is kept
+// until the document, its language or the styles change
+static bool fixedWidthFontKnown = false;
+static bool fixedWidthFont = false;
 
-	selections.erase(uniquify(selections.begin(), selections.end()), selections.end());
+static bool HasFixedWidthFont() {
+	if (!fixedWidthFontKnown) {
+		fixedWidthFont = CheckFixedWidthFont();
+		fixedWidthFontKnown = true;
+	}
+	return fixedWidthFont;
+}
 
-	SetSelections(selections);
+// Whether the plugin is able to move carets for this message exactly like
+// Scintilla would. Anything that depends on layout or folding is left to Scintilla.
+static bool CanMoveInPlugin(int message) {
+	const int codePage = editor.GetCodePage();
+	if (codePage != 0 && codePage != SC_CP_UTF8)
+		return false;
+
+	if (!editor.GetAllLinesVisible())
+		return false;
+
+	if (editor.GetVirtualSpaceOptions() & (SCVS_USERACCESSIBLE | SCVS_NOWRAPLINESTART))
+		return false;
+
+	if (editor.GetLineEndTypesActive() != SC_LINE_END_TYPE_DEFAULT)
+		return false;
+
+	switch (message) {
+		case SCI_VCHOMEWRAP:
+		case SCI_VCHOMEWRAPEXTEND:
+		case SCI_LINEENDWRAP:
+		case SCI_LINEENDWRAPEXTEND:
+			return editor.GetWrapMode() == SC_WRAP_NONE;
+		case SCI_LINEUP:
+		case SCI_LINEUPEXTEND:
+		case SCI_LINEDOWN:
+		case SCI_LINEDOWNEXTEND:
+			return editor.GetWrapMode() == SC_WRAP_NONE && HasFixedWidthFont();
+	}
+
+	return true;
 }
 
-std::string TransformLineEnds(const char *s, int eolModeWanted) {
-	std::string dest;
-	const size_t len = strlen(s);
-	for (size_t i = 0; s[i]; i++) {
-		if (s[i] == '\n' || s[i] == '\r') {
-			if (eolModeWanted == SC_EOL_CR) {
-				dest.push_back('\r');
-			}
-			else if (eolModeWanted == SC_EOL_LF) {
-				dest.push_back('\n');
-			}
-			else { // eolModeWanted == SC_EOL_CRLF
-				dest.push_back('\r');
-				dest.push_back('\n');
+static CharacterClassifier GetCharacterClassifier() {
+	CharacterClassifier classifier;
+
+	// Each set holds every byte at most once so this is always big enough
+	char chars[256 + 1] = { 0 };
+
+	classifier.SetCharClasses(chars, editor.GetWhitespaceChars(chars), ccSpace);
+	classifier.SetCharClasses(chars, editor.GetWordChars(chars), ccWord);
+	classifier.SetCharClasses(chars, editor.GetPunctuationChars(chars), ccPunctuation);
+
+	if (editor.GetCodePage() == SC_CP_UTF8)
+		classifier.SetUnknownAbove(0x7F);
+
+	return classifier;
+}
+
+// Calculate the new selection for the message. Returns false if it needs Scintilla to do it.
+static bool MoveSelection(const DocumentSnapshot &doc, int message, Selection &selection) {
+	Sci_Position pos = DocumentSnapshot::invalidPosition;
+
+	switch (message) {
+		case SCI_CHARLEFT:
+			if (selection.length() > 0) {
+				selection.set(selection.start());
+				return true;
 			}
-			if ((s[i] == '\r') && (i + 1 < len) && (s[i + 1] == '\n')) {
-				i++;
+			// fall through
+		case SCI_CHARLEFTEXTEND:
+			pos = doc.PositionBefore(selection.caret);
+			break;
+		case SCI_CHARRIGHT:
+			if (selection.length() > 0) {
+				selection.set(selection.end());
+				return true;
 			}
-		}
-		else {
-			dest.push_back(s[i]);
-		}
+			// fall through
+		case SCI_CHARRIGHTEXTEND:
+			pos = doc.PositionAfter(selection.caret);
+			break;
+		case SCI_WORDLEFT:
+		case SCI_WORDLEFTEXTEND:
+			pos = doc.NextWordStart(selection.caret, -1);
+			break;
+		case SCI_WORDRIGHT:
+		case SCI_WORDRIGHTEXTEND:
+			pos = doc.NextWordStart(selection.caret, 1);
+			break;
+		case SCI_WORDRIGHTENDEXTEND:
+			pos = doc.NextWordEnd(selection.caret, 1);
+			break;
+		case SCI_VCHOMEWRAP:
+		case SCI_VCHOMEWRAPEXTEND:
+			pos = doc.VCHomePosition(selection.caret);
+			break;
+		case SCI_LINEENDWRAP:
+		case SCI_LINEENDWRAPEXTEND:
+			pos = doc.LineEndPosition(selection.caret);
+			break;
 	}
-	return dest;
-}
 
-const char *StringFromEOLMode(int eolMode) {
-	if (eolMode == SC_EOL_CRLF) {
-		return "\r\n";
+	if (pos == DocumentSnapshot::invalidPosition)
+		return false;
+
+	switch (message) {
+		case SCI_CHARLEFTEXTEND:
+		case SCI_CHARRIGHTEXTEND:
+		case SCI_WORDLEFTEXTEND:
+		case SCI_WORDRIGHTEXTEND:
+		case SCI_WORDRIGHTENDEXTEND:
+		case SCI_VCHOMEWRAPEXTEND:
+		case SCI_LINEENDWRAPEXTEND:
+			selection.caret = pos;
+			break;
+		default:
+			selection.set(pos);
+			break;
 	}
-	else if (eolMode == SC_EOL_CR) {
-		return "\r";
+
+	return true;
+}
+
+// The snapshot covers every caret plus some lines before and after, so moving
+// off the end of a line can be handled
+static DocumentSnapshot TakeSnapshot(const std::vector<Selection> &selections, const CharacterClassifier *classifier = nullptr, int extraLines = 1) {
+	Sci_Position minCaret = selections[0].caret;
+	Sci_Position maxCaret = selections[0].caret;
+	for (const auto &selection : selections) {
+		minCaret = min(minCaret, selection.caret);
+		maxCaret = max(maxCaret, selection.caret);
 	}
-	else {
-		return "\n";
+
+	const Sci_Position length = editor.GetLength();
+	const Sci_Position lineCount = editor.GetLineCount();
+	const Sci_Position firstLine = max(editor.LineFromPosition(minCaret) - extraLines, 0);
+	const Sci_Position lastLine = editor.LineFromPosition(maxCaret) + extraLines + 1;
+	const Sci_Position start = editor.PositionFromLine(firstLine);
+	const Sci_Position end = (lastLine < lineCount) ? editor.PositionFromLine(lastLine) : length;
+	const char *text = editor.GetRangePointer(start, end - start);
+
+	return DocumentSnapshot(text, start, end, length, editor.GetCodePage() == SC_CP_UTF8, classifier);
+}
+
+// Instead of having Scintilla execute the command once per caret, read the text
+// surrounding the carets once and calculate the new positions in a single pass.
+// Any caret that ends up needing text outside of what was read is given to Scintilla.
+static void MoveSelections(int message, int steps = 1) {
+	auto &selections = CurrentSelections();
+
+	if (!CanMoveInPlugin(message) || ChooseStrategy(costs, selections, false, steps) == Strategy::EachSelection) {
+		EditSelections<false>(selections, SimpleEdit(message, steps));
+		return;
 	}
+
+	const CharacterClassifier classifier = IsWordMovement(message) ? GetCharacterClassifier() : CharacterClassifier();
+	const DocumentSnapshot doc = TakeSnapshot(selections, &classifier, steps);
+
+	EditSelections<false>(selections, [&doc, message, steps](Selection &selection) {
+		for (int step = 0; step < steps; ++step) {
+			if (!MoveSelection(doc, message, selection)) {
+				SimpleEdit(message, steps - step)(selection);
+				return;
+			}
+		}
+	});
 }
 
-template <typename T, typename U>
-static std::string join(const std::vector<T> &v, const U &delim) {
-	std::stringstream ss;
-	for (size_t i = 0; i < v.size(); ++i) {
-		if (i != 0) ss << delim;
-		ss << v[i];
+// The selections as they were left by the last up/down movement, along with the
+// column each caret was trying to stay in. Scintilla only remembers one column
+// for the main caret. Only carets that didn't reach their column (e.g. on a
+// shorter line) have it remembered, the rest are in the column they're in.
+static CaretSet verticalSelections;
+static std::vector<std::pair<Sci_Position, Sci_Position>> verticalColumns;
+
+// Swapped with verticalColumns after every movement so neither has to reallocate
+static std::vector<std::pair<Sci_Position, Sci_Position>> columns;
+static std::vector<Sci_Position> lineStarts;
+
+static void MoveSelectionsVertically(int message, int steps = 1) {
+	auto &selections = CurrentSelections();
+
+	if (!CanMoveInPlugin(message) || ChooseStrategy(costs, selections, false, steps) == Strategy::EachSelection) {
+		verticalSelections.clear();
+		EditSelections<false>(selections, SimpleEdit(message, steps));
+		return;
 	}
-	return ss.str();
+
+	if (!verticalSelections.Equals(selections))
+		verticalColumns.clear();
+
+	DocumentSnapshot doc = TakeSnapshot(selections, nullptr, steps);
+	doc.IndexLines(lineStarts);
+
+	const int tabWidth = max(editor.GetTabWidth(), 1);
+	const int direction = (message == SCI_LINEUP || message == SCI_LINEUPEXTEND) ? -1 : 1;
+	const bool extend = (message == SCI_LINEUPEXTEND || message == SCI_LINEDOWNEXTEND);
+
+	columns.clear();
+
+	EditSelections<false>(selections, [&](Selection &selection) {
+		const auto remembered = std::lower_bound(verticalColumns.cbegin(), verticalColumns.cend(), std::make_pair(selection.caret, static_cast<Sci_Position>(INT_MIN)));
+		const Sci_Position column = (remembered != verticalColumns.cend() && remembered->first == selection.caret) ? remembered->second : doc.Column(selection.caret, tabWidth);
+
+		Sci_Position pos = column;
+		for (int step = 0; step < steps && pos != DocumentSnapshot::invalidPosition; ++step) {
+			pos = doc.PositionUpOrDown(step == 0 ? selection.caret : pos, direction, column, tabWidth);
+		}
+
+		if (pos == DocumentSnapshot::invalidPosition) {
+			SimpleEdit(message, steps)(selection);
+			return;
+		}
+
+		if (extend)
+			selection.caret = pos;
+		else
+			selection.set(pos);
+
+		if (doc.Column(pos, tabWidth) != column)
+			columns.emplace_back(pos, column);
+	});
+
+	std::sort(columns.begin(), columns.end());
+	verticalColumns.swap(columns);
+
+	verticalSelections.Assign(selections);
+}
+
+// Unlike EditSelections, the closure only computes what should happen to each
+// selection and never talks to Scintilla. The replacements are then applied in
+// one sweep and the new caret positions are calculated instead of queried back.
+// If the replacements can't be worked out (see GetReplacements) nothing is
+// changed and false is returned.
+template<typename T>
+static bool ReplaceSelections(std::vector<Selection> &selections, T replace) {
+	// Scintilla quietly ignores edits to a read-only document, so the carets
+	// would be moved along for text that never changed. Leaving everything as
+	// it is matches what Scintilla does with the command.
+	if (editor.GetReadOnly())
+		return true;
+
+	// Kept between calls so its memory gets reused
+	static std::vector<Replacement> replacements;
+
+	if (!GetReplacements(selections, replace, replacements))
+		return false;
+
+	if (replacements.empty())
+		return true;
+
+	FrozenView frozenView;
+
+	CoalescedModifications<PositionEditor> coalesced(editor, coalesceModifications, NotifyParent);
+	coalesced.KeepOriginal(replacements.front().start, replacements.back().end);
+	const Sci_Position lengthBefore = editor.GetLength();
+
+	ReplaceText(editor, replacements, costs.edit);
+
+	coalesced.Add(replacements.front().start, replacements.back().end, editor.GetLength() - lengthBefore);
+
+	SetCaretsAfterReplacements(replacements, selections);
+
+	SetSelections(selections);
+
+	return true;
 }
 
-template <typename T>
-static std::vector<std::basic_string<T>> split(std::basic_string<T> const &str, const std::basic_string<T> &delim) {
-	size_t start;
-	size_t end = 0;
-	std::vector<std::basic_string<T>> out;
+// Deleting selected text is the same no matter which message caused it, so it
+// can be done in a batch. For empty carets the character before or after them
+// is found from a snapshot, unless backspace might unindent the line instead.
+static void DeleteSelections(int message) {
+	auto &selections = CurrentSelections();
+
+	const bool allHaveText = std::all_of(selections.cbegin(), selections.cend(), [](const Selection &selection) {
+		return selection.length() > 0;
+	});
+	const bool canBatch = allHaveText || (CanMoveInPlugin(message) && !(message == SCI_DELETEBACK && editor.GetBackSpaceUnIndents()));
+
+	if (canBatch && ChooseStrategy(costs, selections, true, 1) == Strategy::Batch) {
+		const DocumentSnapshot doc = allHaveText ? DocumentSnapshot(nullptr, 0, 0, 0, false) : TakeSnapshot(selections);
+
+		const bool replaced = ReplaceSelections(selections, [&doc, message](const Selection &selection, Replacement &replacement) {
+			if (selection.length() > 0) {
+				replacement = Replacement{ selection.start(), selection.end(), "", 0 };
+				return true;
+			}
 
-	while ((start = str.find_first_not_of(delim, end)) != std::basic_string<T>::npos) {
-		end = str.find(delim, start);
-		out.push_back(str.substr(start, end - start));
+			const Sci_Position pos = (message == SCI_DELETEBACK) ? doc.PositionBefore(selection.caret) : doc.PositionAfter(selection.caret);
+			if (pos == DocumentSnapshot::invalidPosition)
+				return false;
+
+			replacement = Replacement{ min(pos, selection.caret), max(pos, selection.caret), "", 0 };
+			return true;
+		});
+
+		if (replaced)
+			return;
 	}
 
-	return out;
+	EditSelections<true>(selections, SimpleEdit(message));
 }
 
-bool AllSelectionsHaveText(ScintillaEditor &editor) {
-	const int selections = editor.GetSelections();
-	bool has_selections = true;
+// For empty carets the word boundaries can be found from a snapshot, so every
+// word gets deleted in one batch
+static void DeleteWords(int message) {
+	auto &selections = CurrentSelections();
 
-	for (int i = 0; i < editor.GetSelections(); ++i) {
-		int start = editor.GetSelectionNStart(i);
-		int end = editor.GetSelectionNEnd(i);
+	const bool allEmpty = std::all_of(selections.cbegin(), selections.cend(), [](const Selection &selection) {
+		return selection.length() == 0;
+	});
 
-		if (start == end) {
-			return false;
-		}
+	if (allEmpty && CanMoveInPlugin(message) && ChooseStrategy(costs, selections, true, 1) == Strategy::Batch) {
+		const CharacterClassifier classifier = GetCharacterClassifier();
+		const DocumentSnapshot doc = TakeSnapshot(selections, &classifier);
+		const int delta = (message == SCI_DELWORDLEFT) ? -1 : 1;
+
+		const bool replaced = ReplaceSelections(selections, [&doc, delta](const Selection &selection, Replacement &replacement) {
+			const Sci_Position pos = doc.NextWordStart(selection.caret, delta);
+			if (pos == DocumentSnapshot::invalidPosition)
+				return false;
+
+			replacement = Replacement{ min(pos, selection.caret), max(pos, selection.caret), "", 0 };
+			return true;
+		});
+
+		if (replaced)
+			return;
 	}
 
-	return true;
+	EditSelections<true>(selections, SimpleEdit(message));
+}
+
+const char *StringFromEOLMode(int eolMode) {
+	if (eolMode == SC_EOL_CRLF) {
+		return "\r\n";
+	}
+	else if (eolMode == SC_EOL_CR) {
+		return "\r";
+	}
+	else {
+		return "\n";
+	}
 }
 
 // ============================================================================
@@ -318,146 +753,432 @@ UINT CodePageFromCharSet(DWORD characterSet, UINT documentCodePage) {
 	return documentCodePage;
 }
 
+UINT CodePageOfDocument(PositionEditor &editor) {
+	return CodePageFromCharSet(editor.StyleGetCharacterSet(STYLE_DEFAULT), editor.GetCodePage());
+}
 
-// This is a modificated version of ScintillaWin::CopyToClipboard()
-// Multilpe selects can be treated like rectangular and concat'ed together by newlines
-bool CopyToClipboard(ScintillaEditor &editor) {
-	if (!OpenClipboardRetry(editor.GetScintillaInstance())) {
+// The cfMultiSelect data is this header, the length of each selection's text,
+// then the text of every selection one after the other just as it is in the
+// document. Pasting it needs no splitting and keeps line ends within a selection.
+struct MultiSelectHeader {
+	uint32_t count;
+	uint32_t codePage;
+	uint32_t eolMode;
+};
+
+// Fails if a selection is too big to be described by the data
+static bool GetMultiSelectData(PositionEditor &editor, const std::vector<Selection> &selections, std::vector<unsigned char> &data) {
+	size_t bytes = 0;
+	for (const auto &selection : selections) {
+		if (static_cast<unsigned long long>(selection.length()) > UINT32_MAX)
+			return false;
+		bytes += selection.length();
+	}
+
+	data.resize(sizeof(MultiSelectHeader) + selections.size() * sizeof(uint32_t) + bytes);
+
+	const MultiSelectHeader header = { static_cast<uint32_t>(selections.size()), CodePageOfDocument(editor), static_cast<uint32_t>(editor.GetEOLMode()) };
+	unsigned char *out = data.data();
+	memcpy(out, &header, sizeof(header));
+	out += sizeof(header);
+
+	for (const auto &selection : selections) {
+		const uint32_t length = static_cast<uint32_t>(selection.length());
+		memcpy(out, &length, sizeof(length));
+		out += sizeof(length);
+	}
+
+	for (const auto &selection : selections) {
+		const Sci_Position length = selection.length();
+		if (length > 0) {
+			memcpy(out, editor.GetRangePointer(selection.start(), length), length);
+			out += length;
+		}
+	}
+
+	return true;
+}
+
+// Slices the cfMultiSelect data into lines without copying anything. Returns
+// false if the data is damaged.
+static bool ParseMultiSelectData(const void *data, size_t size, MultiSelectHeader &header, std::vector<TextLine> &lines) {
+	if (size < sizeof(header))
+		return false;
+	memcpy(&header, data, sizeof(header));
+
+	if (header.count > (size - sizeof(header)) / sizeof(uint32_t))
 		return false;
+
+	const unsigned char *lengths = static_cast<const unsigned char *>(data) + sizeof(header);
+	const char *text = reinterpret_cast<const char *>(lengths + header.count * sizeof(uint32_t));
+	size_t remaining = size - sizeof(header) - header.count * sizeof(uint32_t);
+
+	lines.clear();
+	for (uint32_t i = 0; i < header.count; ++i) {
+		uint32_t length;
+		memcpy(&length, lengths + i * sizeof(uint32_t), sizeof(length));
+		if (length > remaining)
+			return false;
+
+		lines.push_back(TextLine{ text, length });
+		text += length;
+		remaining -= length;
 	}
 
-	EmptyClipboard();
+	return true;
+}
 
-	GlobalMemory uniText;
+// Also returns false if the data doesn't suit the document, in which case the
+// text gets pasted instead
+static bool GetMultiSelectLines(PositionEditor &editor, const void *data, size_t size, std::vector<TextLine> &lines) {
+	MultiSelectHeader header;
+	if (!ParseMultiSelectData(data, size, header, lines))
+		return false;
 
-	std::string selectedText;
+	if (header.codePage != CodePageOfDocument(editor))
+		return false;
 
-	EditSelections([&selectedText, &editor](Selection& selection) {
-		editor.SetTargetRange(selection.start(), selection.end());
+	// The line ends would have to be searched for to be converted
+	if (editor.GetPasteConvertEndings() && header.eolMode != static_cast<uint32_t>(editor.GetEOLMode()))
+		return false;
 
-		// TODO: check if newline in range and if so abort?
-		// Newlines in the selection will mess up pasting since it
-		// will look like an extra row
+	return true;
+}
 
-		selectedText.append(editor.GetTargetText());
-		selectedText.append(StringFromEOLMode(editor.GetEOLMode()));
-	});
+// MultiByteToWideChar only takes an int length, so longer text is converted a
+// piece at a time without splitting a double byte character. Only counts the
+// characters when out is NULL.
+static size_t WideCharsFromMultiByte(UINT codePage, const char *s, size_t len, wchar_t *out, size_t outLength) {
+	const size_t maxChunk = INT_MAX / 2;
+
+	size_t uchars = 0;
+	while (len > 0) {
+		size_t chunk = len;
+		if (chunk > maxChunk) {
+			chunk = 0;
+			while (chunk < maxChunk)
+				chunk += IsDBCSLeadByteEx(codePage, static_cast<BYTE>(s[chunk])) ? 2 : 1;
+		}
+
+		const int converted = MultiByteToWideChar(codePage, 0, s, static_cast<int>(chunk), out, static_cast<int>(min(outLength, static_cast<size_t>(INT_MAX))));
+		if (converted <= 0)
+			break;
 
-	// Default Scintilla behaviour in Unicode mode
-	if (editor.GetCodePage() == SC_CP_UTF8) {
-		const size_t uchars = UTF16Length(selectedText.c_str(), selectedText.size());
-		uniText.Allocate(2 * uchars);
-		if (uniText) {
-			UTF16FromUTF8(selectedText.c_str(), selectedText.size(), static_cast<wchar_t *>(uniText.ptr), uchars);
+		uchars += converted;
+		if (out) {
+			out += converted;
+			outLength -= converted;
 		}
+		s += chunk;
+		len -= chunk;
 	}
-	else {
-		// Not Unicode mode
-		// Convert to Unicode using the current Scintilla code page
-		const UINT cpSrc = CodePageFromCharSet(editor.StyleGetCharacterSet(STYLE_DEFAULT), editor.GetCodePage());
-		const int uLen = MultiByteToWideChar(cpSrc, 0, selectedText.c_str(), static_cast<int>(selectedText.size()), 0, 0);
-		uniText.Allocate(2 * uLen);
-		if (uniText) {
-			MultiByteToWideChar(cpSrc, 0, selectedText.c_str(), static_cast<int>(selectedText.size()), static_cast<wchar_t *>(uniText.ptr), uLen);
-		}
+	return uchars;
+}
+
+// This is a modificated version of ScintillaWin::CopyToClipboard()
+// Multilpe selects can be treated like rectangular and concat'ed together by newlines.
+// range(i) gives the text of the i-th selection, which is converted straight
+// into the clipboard memory after a first pass to find out how big it needs to
+// be. Reading from Scintilla can move its gap, so the text is only used right away.
+template<typename T>
+static void SetClipboardText(size_t count, UINT codePage, const char *eol, T range) {
+	GlobalMemory uniText;
+
+	const size_t eolLength = strlen(eol);
+	const bool utf8 = codePage == SC_CP_UTF8;
+
+	size_t bytes = 0;
+	size_t uchars = 0;
+	for (size_t i = 0; i < count; ++i) {
+		const TextLine text = range(i);
+		if (text.length > 0)
+			uchars += utf8 ? UTF16LengthOfUTF8(text.text, text.length) : WideCharsFromMultiByte(codePage, text.text, text.length, NULL, 0);
+
+		bytes += text.length + eolLength;
+		uchars += eolLength;
 	}
 
+	// Room for the terminating NUL, which the zeroed memory already has
+	uniText.Allocate(2 * (uchars + 1));
 	if (uniText) {
+		wchar_t *const begin = static_cast<wchar_t *>(uniText.ptr);
+		wchar_t *out = begin;
+		for (size_t i = 0; i < count; ++i) {
+			const TextLine text = range(i);
+			if (text.length > 0) {
+				if (utf8)
+					out = AppendUTF16FromUTF8(text.text, text.length, out);
+				else
+					out += WideCharsFromMultiByte(codePage, text.text, text.length, out, begin + uchars - out);
+			}
+
+			for (size_t j = 0; j < eolLength; ++j)
+				*out++ = eol[j];
+		}
+
 		uniText.SetClip(CF_UNICODETEXT);
 	}
 	else {
 		// There was a failure - try to copy at least ANSI text
 		GlobalMemory ansiText;
-		ansiText.Allocate(selectedText.size());
+		ansiText.Allocate(bytes + 1);
 		if (ansiText) {
-			memcpy(ansiText.ptr, selectedText.c_str(), selectedText.size());
+			char *out = static_cast<char *>(ansiText.ptr);
+			for (size_t i = 0; i < count; ++i) {
+				const TextLine text = range(i);
+				if (text.length > 0) {
+					memcpy(out, text.text, text.length);
+					out += text.length;
+				}
+
+				memcpy(out, eol, eolLength);
+				out += eolLength;
+			}
+
 			ansiText.SetClip(CF_TEXT);
 		}
 	}
+}
 
-	SetClipboardData(cfColumnSelect, 0);
-	SetClipboardData(cfMultiSelect, 0);
+// While the plugin owns the clipboard it keeps the cfMultiSelect data of what
+// was copied, and the other formats are only made from it when something asks
+// for them. Pasting with the plugin uses the data directly.
+static HWND clipboardWindow = NULL;
+static std::vector<unsigned char> copiedData;
+static std::vector<TextLine> copiedLines;
+static bool pastingCopiedData = false;
 
-	CloseClipboard();
+// Defined with the rest of what is kept for pasting
+static void ReleaseDecodedLines();
 
-	return true;
+static void ReleaseCopiedData() {
+	std::vector<unsigned char>().swap(copiedData);
+	std::vector<TextLine>().swap(copiedLines);
 }
 
-UINT CodePageOfDocument(ScintillaEditor &editor) {
-	return CodePageFromCharSet(editor.StyleGetCharacterSet(STYLE_DEFAULT), editor.GetCodePage());
+static void RenderFormat(UINT format) {
+	if (format == CF_UNICODETEXT) {
+		MultiSelectHeader header;
+		if (ParseMultiSelectData(copiedData.data(), copiedData.size(), header, copiedLines)) {
+			SetClipboardText(copiedLines.size(), header.codePage, StringFromEOLMode(header.eolMode), [](size_t i) {
+				return copiedLines[i];
+			});
+		}
+	}
+	else if (format == cfMultiSelect && !copiedData.empty()) {
+		GlobalMemory data;
+		data.Allocate(copiedData.size());
+		if (data) {
+			memcpy(data.ptr, copiedData.data(), copiedData.size());
+			data.SetClip(cfMultiSelect);
+		}
+	}
 }
 
-bool InsertMultiCursorPaste(ScintillaEditor &editor, const char *text) {
-	std::string st;
+static LRESULT CALLBACK ClipboardWindowProc(HWND hwnd, UINT message, WPARAM wParam, LPARAM lParam) {
+	switch (message) {
+		case WM_RENDERFORMAT:
+			RenderFormat(static_cast<UINT>(wParam));
+			return 0;
+		case WM_RENDERALLFORMATS:
+			// Sent before the window goes away so the clipboard keeps the text
+			if (OpenClipboard(hwnd)) {
+				if (GetClipboardOwner() == hwnd) {
+					RenderFormat(CF_UNICODETEXT);
+					RenderFormat(cfMultiSelect);
+				}
+				CloseClipboard();
+			}
+			return 0;
+		case WM_CLIPBOARDUPDATE:
+			ReleaseDecodedLines();
+			return 0;
+		case WM_DESTROYCLIPBOARD:
+			// A paste that is using the data lets it go once it is done
+			if (!pastingCopiedData)
+				ReleaseCopiedData();
+			return 0;
+	}
+	return DefWindowProc(hwnd, message, wParam, lParam);
+}
 
-	if (editor.GetPasteConvertEndings()) {
-		st = TransformLineEnds(text, editor.GetEOLMode());
+static const wchar_t *const clipboardClassName = TEXT("BetterMultiSelectionClipboard");
+
+// A message only window that owns the clipboard and hears about it changing,
+// created on the first copy or paste
+static HWND GetClipboardWindow() {
+	if (clipboardWindow == NULL) {
+		WNDCLASS wc = { 0 };
+		wc.lpfnWndProc = ClipboardWindowProc;
+		wc.hInstance = (HINSTANCE)_hModule;
+		wc.lpszClassName = clipboardClassName;
+		RegisterClass(&wc);
+
+		clipboardWindow = CreateWindowEx(0, wc.lpszClassName, TEXT(""), 0, 0, 0, 0, 0, HWND_MESSAGE, NULL, wc.hInstance, NULL);
+		if (clipboardWindow != NULL)
+			AddClipboardFormatListener(clipboardWindow);
 	}
-	else {
-		st = text;
+	return clipboardWindow;
+}
+
+// The class goes as well, otherwise it would still point at this DLL's window
+// procedure after it is unloaded
+static void DestroyClipboardWindow() {
+	if (clipboardWindow != NULL) {
+		RemoveClipboardFormatListener(clipboardWindow);
+		DestroyWindow(clipboardWindow);
+		clipboardWindow = NULL;
+		UnregisterClass(clipboardClassName, (HINSTANCE)_hModule);
 	}
+}
 
-	auto lines = split(st, std::string(StringFromEOLMode(editor.GetEOLMode())));
-	if (lines.size() == editor.GetSelections()) {
-		EditSelections([&lines, &editor](Selection &selection) {
-			if (selection.caret < selection.anchor)
-				editor.SetTargetRange(selection.caret, selection.anchor);
-			else
-				editor.SetTargetRange(selection.anchor, selection.caret);
+// The selections have to be sorted and merged already. The document and the
+// selections are left alone.
+static bool CopyToClipboard(PositionEditor &editor, const std::vector<Selection> &selections) {
+	HWND owner = GetClipboardWindow();
+	if (!OpenClipboardRetry(owner ? owner : editor.GetScintillaInstance())) {
+		return false;
+	}
 
-			editor.ReplaceTarget(lines[0]);
+	// Lets go of anything copied before
+	EmptyClipboard();
 
-			selection.caret = editor.GetTargetEnd();
-			selection.anchor = editor.GetTargetEnd();
+	if (owner && GetMultiSelectData(editor, selections, copiedData)) {
+		SetClipboardData(CF_UNICODETEXT, NULL);
+		SetClipboardData(cfMultiSelect, NULL);
+	}
+	else {
+		ReleaseCopiedData();
 
-			// pop front
-			lines.erase(lines.cbegin());
+		SetClipboardText(selections.size(), CodePageOfDocument(editor), StringFromEOLMode(editor.GetEOLMode()), [&editor, &selections](size_t i) {
+			const Sci_Position length = selections[i].length();
+			return TextLine{ (length > 0) ? editor.GetRangePointer(selections[i].start(), length) : "", static_cast<size_t>(length) };
 		});
-
-		return true;
+		SetClipboardData(cfMultiSelect, 0);
 	}
 
-	return false;
+	SetClipboardData(cfColumnSelect, 0);
+
+	CloseClipboard();
+
+	return true;
 }
 
-bool Paste(ScintillaEditor &editor) {
-	if (!IsClipboardFormatAvailable(cfColumnSelect) && !IsClipboardFormatAvailable(cfMultiSelect))
+bool CopyToClipboard(PositionEditor &editor) {
+	auto &selections = CurrentSelections();
+	MergeSelections(selections);
+
+	return CopyToClipboard(editor, selections);
+}
+
+// Copies the selections then deletes the selected text in one sweep, so there
+// is a single undo action and the selections are only set once. Empty carets
+// are copied as empty lines and nothing is deleted at them.
+bool CutToClipboard(PositionEditor &editor) {
+	auto &selections = CurrentSelections();
+	MergeSelections(selections);
+
+	if (!CopyToClipboard(editor, selections))
 		return false;
 
-	if (!OpenClipboardRetry(editor.GetScintillaInstance())) {
+	ReplaceSelections(selections, [](const Selection &selection, Replacement &replacement) {
+		replacement = Replacement{ selection.start(), selection.end(), "", 0 };
+		return true;
+	});
+
+	return true;
+}
+
+// Each selection is replaced by the line with the same index, all in one
+// batch with a single undo action
+bool InsertMultiCursorPaste(PositionEditor &editor, const std::vector<TextLine> &lines) {
+	auto &selections = CurrentSelections();
+	MergeSelections(selections);
+
+	if (lines.size() != selections.size())
 		return false;
+
+	size_t line = 0;
+	ReplaceSelections(selections, [&lines, &line](const Selection &selection, Replacement &replacement) {
+		replacement = Replacement{ selection.start(), selection.end(), lines[line].text, static_cast<Sci_Position>(lines[line].length) };
+		++line;
+		return true;
+	});
+
+	return true;
+}
+
+// Lines decoded from one of the clipboard formats
+struct ClipboardLines {
+	bool decoded = false;
+	bool usable = false;
+	std::string buffer;
+	std::vector<TextLine> lines;
+};
+
+// What was decoded is kept until the clipboard changes, or until it is pasted
+// into a document that wants different encoding or line ends, so pasting the
+// same thing again doesn't decode it again. The clipboard window lets it all go
+// as soon as the clipboard changes rather than holding it until the next paste.
+static DWORD decodedSequence = 0;
+static UINT decodedCodePage = 0;
+static int decodedEOLMode = -1;
+static bool decodedConvertLineEnds = false;
+static ClipboardLines multiSelectLines;
+static ClipboardLines textLines;
+
+static void ReleaseDecodedLines() {
+	decodedSequence = 0;
+	multiSelectLines = ClipboardLines();
+	textLines = ClipboardLines();
+}
+
+// The data is copied out of the clipboard so it can be kept
+static void DecodeMultiSelectData(PositionEditor &editor, ClipboardLines &decoded) {
+	decoded.decoded = true;
+	decoded.usable = false;
+
+	GlobalMemory memMultiSelect(::GetClipboardData(cfMultiSelect));
+	if (memMultiSelect) {
+		decoded.buffer.assign(static_cast<const char *>(memMultiSelect.ptr), memMultiSelect.Size());
+		memMultiSelect.Unlock();
+
+		decoded.usable = GetMultiSelectLines(editor, decoded.buffer.data(), decoded.buffer.size(), decoded.lines);
 	}
+}
+
+// The clipboard text is converted and split into lines in one go, with the
+// lines pointing into the buffer
+static void DecodeText(PositionEditor &editor, ClipboardLines &decoded) {
+	decoded.decoded = true;
+	decoded.usable = false;
+
+	const bool convertLineEnds = editor.GetPasteConvertEndings();
+	const char *eol = StringFromEOLMode(editor.GetEOLMode());
 
 	// Always use CF_UNICODETEXT if available
 	GlobalMemory memUSelection(::GetClipboardData(CF_UNICODETEXT));
 	if (memUSelection) {
 		const wchar_t *uptr = static_cast<const wchar_t *>(memUSelection.ptr);
 		if (uptr) {
-			size_t len;
-			std::vector<char> putf;
 			// Default Scintilla behaviour in Unicode mode
 			if (editor.GetCodePage() == SC_CP_UTF8) {
 				const size_t bytes = memUSelection.Size();
-				len = UTF8Length(uptr, bytes / 2);
-				putf.resize(len + 1);
-				UTF8FromUTF16(uptr, bytes / 2, &putf[0], len);
+				UTF8LinesFromUTF16(uptr, bytes / 2, convertLineEnds, eol, decoded.buffer, decoded.lines);
 			}
 			else {
 				// CF_UNICODETEXT available, but not in Unicode mode
 				// Convert from Unicode to current Scintilla code page
 				const UINT cpDest = CodePageOfDocument(editor);
-				len = WideCharToMultiByte(cpDest, 0, uptr, -1, NULL, 0, NULL, NULL) - 1; // subtract 0 terminator
-				putf.resize(len + 1);
-				WideCharToMultiByte(cpDest, 0, uptr, -1, &putf[0], static_cast<int>(len) + 1, NULL, NULL);
+				const int len = max(WideCharToMultiByte(cpDest, 0, uptr, -1, NULL, 0, NULL, NULL) - 1, 0); // subtract 0 terminator
+				decoded.buffer.resize(len + 1);
+				WideCharToMultiByte(cpDest, 0, uptr, -1, &decoded.buffer[0], len + 1, NULL, NULL);
+				SplitLines(decoded.buffer.data(), len, convertLineEnds, eol, decoded.lines);
 			}
 
-			if (InsertMultiCursorPaste(editor, &putf[0])) {
-				memUSelection.Unlock();
-				CloseClipboard();
-				return true;
-			}
+			decoded.usable = true;
 		}
-		
+		memUSelection.Unlock();
 	}
 	else {
 		// CF_UNICODETEXT not available, paste ANSI text
@@ -479,57 +1200,162 @@ bool Paste(ScintillaEditor &editor) {
 					const int ilen = static_cast<int>(len);
 					const size_t ulen = ::MultiByteToWideChar(CP_ACP, 0, ptr, ilen, &uptr[0], ilen + 1);
 
-					const size_t mlen = UTF8Length(&uptr[0], ulen);
-					std::vector<char> putf(mlen + 1);
-					UTF8FromUTF16(&uptr[0], ulen, &putf[0], mlen);
-
-					if (InsertMultiCursorPaste(editor, &putf[0])) {
-						memSelection.Unlock();
-						CloseClipboard();
-						return true;
-					}
+					UTF8LinesFromUTF16(&uptr[0], ulen, convertLineEnds, eol, decoded.buffer, decoded.lines);
 				}
 				else {
-					if (InsertMultiCursorPaste(editor, ptr)) {
-						memSelection.Unlock();
-						CloseClipboard();
-						return true;
-					}
+					decoded.buffer.assign(ptr, len);
+					SplitLines(decoded.buffer.data(), len, convertLineEnds, eol, decoded.lines);
 				}
+
+				decoded.usable = true;
 			}
+			memSelection.Unlock();
 		}
 	}
+}
 
-	CloseClipboard();
-	return false;
+// Text copied by this plugin is pasted straight from its cfMultiSelect data.
+// Otherwise the clipboard is only opened to decode what isn't decoded already.
+bool Paste(PositionEditor &editor) {
+	if (!IsClipboardFormatAvailable(cfColumnSelect) && !IsClipboardFormatAvailable(cfMultiSelect))
+		return false;
+
+	// Copied by this plugin, so the clipboard isn't needed at all
+	if (clipboardWindow != NULL && GetClipboardOwner() == clipboardWindow) {
+		static std::vector<TextLine> lines;
+
+		pastingCopiedData = true;
+		const bool pasted = GetMultiSelectLines(editor, copiedData.data(), copiedData.size(), lines) && InsertMultiCursorPaste(editor, lines);
+		pastingCopiedData = false;
+
+		if (GetClipboardOwner() != clipboardWindow)
+			ReleaseCopiedData();
+		if (pasted)
+			return true;
+	}
+
+	// Without a sequence number there is no telling whether the clipboard changed
+	const DWORD sequence = GetClipboardSequenceNumber();
+	const UINT codePage = CodePageOfDocument(editor);
+	const int eolMode = editor.GetEOLMode();
+	const bool convertLineEnds = editor.GetPasteConvertEndings();
+	if (sequence == 0 || sequence != decodedSequence || codePage != decodedCodePage || eolMode != decodedEOLMode || convertLineEnds != decodedConvertLineEnds) {
+		decodedSequence = sequence;
+		decodedCodePage = codePage;
+		decodedEOLMode = eolMode;
+		decodedConvertLineEnds = convertLineEnds;
+		multiSelectLines.decoded = false;
+		textLines.decoded = false;
+	}
+
+	// Listen for the clipboard changing before decoding anything to keep
+	GetClipboardWindow();
+
+	bool opened = false;
+	if (!multiSelectLines.decoded) {
+		if (!OpenClipboardRetry(editor.GetScintillaInstance())) {
+			return false;
+		}
+		opened = true;
+
+		// Copied by this plugin so each selection's text is known exactly
+		DecodeMultiSelectData(editor, multiSelectLines);
+	}
+
+	bool pasted = multiSelectLines.usable && InsertMultiCursorPaste(editor, multiSelectLines.lines);
+
+	if (!pasted && !textLines.decoded) {
+		if (!opened && !OpenClipboardRetry(editor.GetScintillaInstance())) {
+			return false;
+		}
+		opened = true;
+
+		DecodeText(editor, textLines);
+	}
+
+	if (opened)
+		CloseClipboard();
+
+	if (!pasted)
+		pasted = textLines.usable && InsertMultiCursorPaste(editor, textLines.lines);
+
+	return pasted;
+}
+
+// Holding down a key with lots of carets can queue up repeats faster than they
+// can be handled, leaving the carets moving long after the key is released. Any
+// repeats of the same key that are already waiting get handled along with this one.
+static bool coalescingRepeats = false;
+
+#ifdef _DEBUG
+// How well coalescing keeps up, shown in the debugger's output
+static unsigned long long repeatsHandled = 0;
+static unsigned long long repeatsCoalesced = 0;
+#endif
+
+static int CoalesceKeyRepeats(WPARAM wparam, LPARAM lparam) {
+	int steps = max(LOWORD(lparam), 1);
+
+	if ((HIWORD(lparam) & KF_REPEAT) == 0)
+		return steps;
+
+	// Removing a message runs it through this hook again
+	coalescingRepeats = true;
+
+	MSG msg;
+	while (PeekMessage(&msg, NULL, WM_KEYFIRST, WM_KEYLAST, PM_NOREMOVE | PM_NOYIELD)) {
+		if (msg.message != WM_KEYDOWN || msg.wParam != wparam || (HIWORD(msg.lParam) & KF_REPEAT) == 0)
+			break;
+
+		PeekMessage(&msg, NULL, WM_KEYDOWN, WM_KEYDOWN, PM_REMOVE | PM_NOYIELD);
+		steps += max(LOWORD(msg.lParam), 1);
+	}
+
+	coalescingRepeats = false;
+
+#ifdef _DEBUG
+	repeatsHandled += steps;
+	repeatsCoalesced += steps - 1;
+
+	char stats[128];
+	sprintf_s(stats, "BetterMultiSelection: moved %d steps at once, %llu of %llu repeats coalesced\n", steps, repeatsCoalesced, repeatsHandled);
+	OutputDebugStringA(stats);
+#endif
+
+	return steps;
 }
 
 LRESULT CALLBACK KeyboardProc(int ncode, WPARAM wparam, LPARAM lparam) {
+	if (coalescingRepeats)
+		return CallNextHookEx(hook, ncode, wparam, lparam);
+
 	if (ncode == HC_ACTION && (HIWORD(lparam) & KF_UP) == 0 && !IsAltPressed()) {
 		if (hasFocus && editor.GetSelections() > 1) {
 			if (IsControlPressed()) {
 				if (wparam == VK_LEFT) {
-					EditSelections(SimpleEdit(IsShiftPressed() ? SCI_WORDLEFTEXTEND : SCI_WORDLEFT));
+					MoveSelections(IsShiftPressed() ? SCI_WORDLEFTEXTEND : SCI_WORDLEFT, CoalesceKeyRepeats(wparam, lparam));
 					return TRUE; // This key has been "handled" and won't propogate
 				}
 				else if (wparam == VK_RIGHT) {
-					EditSelections(SimpleEdit(IsShiftPressed() ? SCI_WORDRIGHTENDEXTEND : SCI_WORDRIGHT));
+					MoveSelections(IsShiftPressed() ? SCI_WORDRIGHTENDEXTEND : SCI_WORDRIGHT, CoalesceKeyRepeats(wparam, lparam));
 					return TRUE;
 				}
 				else if (!IsShiftPressed()) { // Handle CTRL+{} only, allow CTRL+SHIFT+{} to be used elsewhere
 					if (wparam == VK_BACK) {
-						EditSelections(SimpleEdit(SCI_DELWORDLEFT));
+						DeleteWords(SCI_DELWORDLEFT);
 						return TRUE;
 					}
 					else if (wparam == VK_DELETE) {
-						EditSelections(SimpleEdit(SCI_DELWORDRIGHT));
+						DeleteWords(SCI_DELWORDRIGHT);
 						return TRUE;
 					}
-					else if (wparam == 'X' || wparam == 'C') {
+					else if (wparam == 'X') {
+						if (CutToClipboard(editor)) {
+							return TRUE;
+						}
+					}
+					else if (wparam == 'C') {
 						if (CopyToClipboard(editor)) {
-							if (wparam == 'X') {
-								EditSelections(SimpleEdit(SCI_DELETEBACK));
-							}
 							return TRUE;
 						}
 					}
@@ -542,32 +1368,32 @@ LRESULT CALLBACK KeyboardProc(int ncode, WPARAM wparam, LPARAM lparam) {
 			}
 			else {
 				if (wparam == VK_ESCAPE) {
-					int caret = editor.GetSelectionNCaret(editor.GetMainSelection());
+					Sci_Position caret = editor.GetSelectionNCaret(editor.GetMainSelection());
 					editor.SetSelection(caret, caret);
 					return TRUE;
 				}
 				else if (wparam == VK_LEFT) {
-					EditSelections(SimpleEdit(IsShiftPressed() ? SCI_CHARLEFTEXTEND : SCI_CHARLEFT));
+					MoveSelections(IsShiftPressed() ? SCI_CHARLEFTEXTEND : SCI_CHARLEFT, CoalesceKeyRepeats(wparam, lparam));
 					return TRUE;
 				}
 				else if (wparam == VK_RIGHT) {
-					EditSelections(SimpleEdit(IsShiftPressed() ? SCI_CHARRIGHTEXTEND : SCI_CHARRIGHT));
+					MoveSelections(IsShiftPressed() ? SCI_CHARRIGHTEXTEND : SCI_CHARRIGHT, CoalesceKeyRepeats(wparam, lparam));
 					return TRUE;
 				}
 				else if (wparam == VK_HOME) {
-					EditSelections(SimpleEdit(IsShiftPressed() ? SCI_VCHOMEWRAPEXTEND : SCI_VCHOMEWRAP));
+					MoveSelections(IsShiftPressed() ? SCI_VCHOMEWRAPEXTEND : SCI_VCHOMEWRAP, CoalesceKeyRepeats(wparam, lparam));
 					return TRUE;
 				}
 				else if (wparam == VK_END) {
-					EditSelections(SimpleEdit(IsShiftPressed() ? SCI_LINEENDWRAPEXTEND : SCI_LINEENDWRAP));
+					MoveSelections(IsShiftPressed() ? SCI_LINEENDWRAPEXTEND : SCI_LINEENDWRAP, CoalesceKeyRepeats(wparam, lparam));
 					return TRUE;
 				}
 				else if (wparam == VK_BACK) {
-					EditSelections(SimpleEdit(SCI_DELETEBACK));
+					DeleteSelections(SCI_DELETEBACK);
 					return TRUE;
 				}
 				else if (wparam == VK_DELETE) {
-					EditSelections(SimpleEdit(SCI_CLEAR));
+					DeleteSelections(SCI_CLEAR);
 					return TRUE;
 				}
 				else if (wparam == VK_RETURN) {
@@ -579,14 +1405,14 @@ LRESULT CALLBACK KeyboardProc(int ncode, WPARAM wparam, LPARAM lparam) {
 				}
 				else if (wparam == VK_UP) {
 					if (!editor.AutoCActive()) {
-						EditSelections(SimpleEdit(IsShiftPressed() ? SCI_LINEUPEXTEND : SCI_LINEUP));
+						MoveSelectionsVertically(IsShiftPressed() ? SCI_LINEUPEXTEND : SCI_LINEUP, CoalesceKeyRepeats(wparam, lparam));
 						return TRUE;
 					}
 					// else just let Scintilla handle the navigation of autocompletion
 				}
 				else if (wparam == VK_DOWN) {
 					if (!editor.AutoCActive()) {
-						EditSelections(SimpleEdit(IsShiftPressed() ? SCI_LINEDOWNEXTEND : SCI_LINEDOWN));
+						MoveSelectionsVertically(IsShiftPressed() ? SCI_LINEDOWNEXTEND : SCI_LINEDOWN, CoalesceKeyRepeats(wparam, lparam));
 						return TRUE;
 					}
 					// else just let Scintilla handle the navigation of autocompletion
@@ -637,6 +1463,18 @@ extern "C" __declspec(dllexport) void beNotified(SCNotification *notifyCode) {
 		case SCN_CHARADDED:
 			//if (editor.GetSelections() > 1)
 
+			break;
+		case SCN_MODIFIED:
+			if (notifyCode->modificationType & (SC_MOD_INSERTTEXT | SC_MOD_DELETETEXT)) {
+				// The plugin's own edits set the selections again afterwards
+				if (!FrozenView::Active() && notifyCode->nmhdr.hwndFrom == editor.GetScintillaInstance())
+					shadowSelections.Update((notifyCode->modificationType & SC_MOD_INSERTTEXT) != 0, notifyCode->position, notifyCode->length);
+				// The same document can be open in the other view as well, and
+				// text changed there moves the selections here all the same.
+				// Where exactly they end up isn't worth working out.
+				else if (!FrozenView::Active() && IsOtherViewOfDocument(notifyCode->nmhdr.hwndFrom))
+					shadowSelections.Invalidate();
+			}
 			break;
 		case SCN_FOCUSIN:
 			hasFocus = true;
@@ -645,7 +1483,13 @@ extern "C" __declspec(dllexport) void beNotified(SCNotification *notifyCode) {
 			hasFocus = false;
 			break;
 		case NPPN_READY: {
+			fixedWidthFontKnown = false;
 			bool isEnabled = GetPrivateProfileInt(TEXT("BetterMultiSelection"), TEXT("enabled"), 1, GetIniFilePath()) == 1;
+			coalesceModifications = GetPrivateProfileInt(TEXT("BetterMultiSelection"), TEXT("coalesceModifications"), 0, GetIniFilePath()) == 1;
+			costs.move = ReadCost(TEXT("moveCost"), costs.move);
+			costs.edit = ReadCost(TEXT("editCost"), costs.edit);
+			costs.batch = ReadCost(TEXT("batchCost"), costs.batch);
+			costs.caret = ReadCost(TEXT("caretCost"), costs.caret);
 			if (isEnabled) {
 				enableBetterMultiSelection();
 			}
@@ -653,10 +1497,22 @@ extern "C" __declspec(dllexport) void beNotified(SCNotification *notifyCode) {
 		}
 		case NPPN_SHUTDOWN:
 			WritePrivateProfileString(TEXT("BetterMultiSelection"), TEXT("enabled"), hook ? TEXT("1") : TEXT("0"), GetIniFilePath());
+			WritePrivateProfileString(TEXT("BetterMultiSelection"), TEXT("coalesceModifications"), coalesceModifications ? TEXT("1") : TEXT("0"), GetIniFilePath());
+			WriteCost(TEXT("moveCost"), costs.move);
+			WriteCost(TEXT("editCost"), costs.edit);
+			WriteCost(TEXT("batchCost"), costs.batch);
+			WriteCost(TEXT("caretCost"), costs.caret);
 			if (hook != NULL)
 				UnhookWindowsHookEx(hook);
+			DestroyClipboardWindow();
+			break;
+		case NPPN_LANGCHANGED:
+		case NPPN_WORDSTYLESUPDATED:
+			fixedWidthFontKnown = false;
 			break;
 		case NPPN_BUFFERACTIVATED:
+			fixedWidthFontKnown = false;
+			shadowSelections.Invalidate();
 			editor.SetScintillaInstance(GetCurrentScintilla());
 			editor.AutoCSetMulti(SC_MULTIAUTOC_EACH);
 			break;
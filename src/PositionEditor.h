@@ -0,0 +1,207 @@
+// This file is part of BetterMultiSelection.
+// 
+// Copyright (C)2017 Justin Dailey <dail8859@yahoo.com>
+// 
+// BetterMultiSelection is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+
+#pragma once
+
+#include "ScintillaEditor.h"
+
+// ScintillaEditor.h is generated from Scintilla.iface, which still declares
+// positions and lines as int. Documents over 2 GB need the full Sci_Position
+// range in 64-bit builds, so the messages the plugin sends with positions or
+// lines are wrapped again here. These hide the int versions, and regenerating
+// ScintillaEditor.h leaves them alone.
+class PositionEditor final : public ScintillaEditor {
+public:
+	PositionEditor() {}
+
+	explicit PositionEditor(HWND scintilla) : ScintillaEditor(scintilla) {}
+
+	Sci_Position GetLength() const {
+		sptr_t res = Call(SCI_GETLENGTH, SCI_UNUSED, SCI_UNUSED);
+		return static_cast<Sci_Position>(res);
+	}
+
+	Sci_Position GetCurrentPos() const {
+		sptr_t res = Call(SCI_GETCURRENTPOS, SCI_UNUSED, SCI_UNUSED);
+		return static_cast<Sci_Position>(res);
+	}
+
+	Sci_Position GetAnchor() const {
+		sptr_t res = Call(SCI_GETANCHOR, SCI_UNUSED, SCI_UNUSED);
+		return static_cast<Sci_Position>(res);
+	}
+
+	const char* GetRangePointer(Sci_Position start, Sci_Position lengthRange) const {
+		sptr_t res = Call(SCI_GETRANGEPOINTER, start, lengthRange);
+		return reinterpret_cast<const char*>(res);
+	}
+
+	Sci_Position GetGapPosition() const {
+		sptr_t res = Call(SCI_GETGAPPOSITION, SCI_UNUSED, SCI_UNUSED);
+		return static_cast<Sci_Position>(res);
+	}
+
+	// Lines
+
+	Sci_Position GetLineCount() const {
+		sptr_t res = Call(SCI_GETLINECOUNT, SCI_UNUSED, SCI_UNUSED);
+		return static_cast<Sci_Position>(res);
+	}
+
+	Sci_Position LineFromPosition(Sci_Position pos) const {
+		sptr_t res = Call(SCI_LINEFROMPOSITION, pos, SCI_UNUSED);
+		return static_cast<Sci_Position>(res);
+	}
+
+	Sci_Position PositionFromLine(Sci_Position line) const {
+		sptr_t res = Call(SCI_POSITIONFROMLINE, line, SCI_UNUSED);
+		return static_cast<Sci_Position>(res);
+	}
+
+	Sci_Position GetLineEndPosition(Sci_Position line) const {
+		sptr_t res = Call(SCI_GETLINEENDPOSITION, line, SCI_UNUSED);
+		return static_cast<Sci_Position>(res);
+	}
+
+	Sci_Position GetFirstVisibleLine() const {
+		sptr_t res = Call(SCI_GETFIRSTVISIBLELINE, SCI_UNUSED, SCI_UNUSED);
+		return static_cast<Sci_Position>(res);
+	}
+
+	void SetFirstVisibleLine(Sci_Position displayLine) const {
+		Call(SCI_SETFIRSTVISIBLELINE, displayLine, SCI_UNUSED);
+	}
+
+	// Markers, indicators and annotations
+
+	Sci_Position MarkerNext(Sci_Position lineStart, int markerMask) const {
+		sptr_t res = Call(SCI_MARKERNEXT, lineStart, markerMask);
+		return static_cast<Sci_Position>(res);
+	}
+
+	int IndicatorValueAt(int indicator, Sci_Position pos) const {
+		sptr_t res = Call(SCI_INDICATORVALUEAT, indicator, pos);
+		return static_cast<int>(res);
+	}
+
+	Sci_Position IndicatorEnd(int indicator, Sci_Position pos) const {
+		sptr_t res = Call(SCI_INDICATOREND, indicator, pos);
+		return static_cast<Sci_Position>(res);
+	}
+
+	int MarginGetText(Sci_Position line, char* text) const {
+		sptr_t res = Call(SCI_MARGINGETTEXT, line, text);
+		return static_cast<int>(res);
+	}
+
+	int AnnotationGetLines(Sci_Position line) const {
+		sptr_t res = Call(SCI_ANNOTATIONGETLINES, line, SCI_UNUSED);
+		return static_cast<int>(res);
+	}
+
+	// Target
+
+	void SetTargetStart(Sci_Position start) const {
+		Call(SCI_SETTARGETSTART, start, SCI_UNUSED);
+	}
+
+	Sci_Position GetTargetStart() const {
+		sptr_t res = Call(SCI_GETTARGETSTART, SCI_UNUSED, SCI_UNUSED);
+		return static_cast<Sci_Position>(res);
+	}
+
+	void SetTargetEnd(Sci_Position end) const {
+		Call(SCI_SETTARGETEND, end, SCI_UNUSED);
+	}
+
+	Sci_Position GetTargetEnd() const {
+		sptr_t res = Call(SCI_GETTARGETEND, SCI_UNUSED, SCI_UNUSED);
+		return static_cast<Sci_Position>(res);
+	}
+
+	void SetTargetRange(Sci_Position start, Sci_Position end) const {
+		Call(SCI_SETTARGETRANGE, start, end);
+	}
+
+	Sci_Position ReplaceTarget(Sci_Position length, const char* text) const {
+		sptr_t res = Call(SCI_REPLACETARGET, length, text);
+		return static_cast<Sci_Position>(res);
+	}
+
+	Sci_Position ReplaceTarget(const std::string& text) const {
+		sptr_t res = Call(SCI_REPLACETARGET, text.length(), text.c_str());
+		return static_cast<Sci_Position>(res);
+	}
+
+	// Selections
+
+	void SetSelection(Sci_Position caret, Sci_Position anchor) const {
+		Call(SCI_SETSELECTION, caret, anchor);
+	}
+
+	void AddSelection(Sci_Position caret, Sci_Position anchor) const {
+		Call(SCI_ADDSELECTION, caret, anchor);
+	}
+
+	Sci_Position GetSelectionNCaret(int selection) const {
+		sptr_t res = Call(SCI_GETSELECTIONNCARET, selection, SCI_UNUSED);
+		return static_cast<Sci_Position>(res);
+	}
+
+	Sci_Position GetSelectionNAnchor(int selection) const {
+		sptr_t res = Call(SCI_GETSELECTIONNANCHOR, selection, SCI_UNUSED);
+		return static_cast<Sci_Position>(res);
+	}
+
+	void SetSelectionNCaret(int selection, Sci_Position caret) const {
+		Call(SCI_SETSELECTIONNCARET, selection, caret);
+	}
+
+	void SetSelectionNAnchor(int selection, Sci_Position anchor) const {
+		Call(SCI_SETSELECTIONNANCHOR, selection, anchor);
+	}
+
+	Sci_Position GetSelectionNStart(int selection) const {
+		sptr_t res = Call(SCI_GETSELECTIONNSTART, selection, SCI_UNUSED);
+		return static_cast<Sci_Position>(res);
+	}
+
+	Sci_Position GetSelectionNEnd(int selection) const {
+		sptr_t res = Call(SCI_GETSELECTIONNEND, selection, SCI_UNUSED);
+		return static_cast<Sci_Position>(res);
+	}
+
+	void SetRectangularSelectionCaret(Sci_Position caret) const {
+		Call(SCI_SETRECTANGULARSELECTIONCARET, caret, SCI_UNUSED);
+	}
+
+	Sci_Position GetRectangularSelectionCaret() const {
+		sptr_t res = Call(SCI_GETRECTANGULARSELECTIONCARET, SCI_UNUSED, SCI_UNUSED);
+		return static_cast<Sci_Position>(res);
+	}
+
+	void SetRectangularSelectionAnchor(Sci_Position anchor) const {
+		Call(SCI_SETRECTANGULARSELECTIONANCHOR, anchor, SCI_UNUSED);
+	}
+
+	Sci_Position GetRectangularSelectionAnchor() const {
+		sptr_t res = Call(SCI_GETRECTANGULARSELECTIONANCHOR, SCI_UNUSED, SCI_UNUSED);
+		return static_cast<Sci_Position>(res);
+	}
+};
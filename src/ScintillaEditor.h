@@ -32,7 +32,7 @@ typedef struct {
 typedef int Colour;
 typedef int KeyModifier;
 
-class ScintillaEditor final {
+class ScintillaEditor {
 private:
 	HWND scintilla = nullptr;
 	SciFnDirect directFunction = nullptr;
@@ -0,0 +1,78 @@
+// This file is part of BetterMultiSelection.
+// 
+// Copyright (C)2017 Justin Dailey <dail8859@yahoo.com>
+// 
+// BetterMultiSelection is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+#include <algorithm>
+
+#include "SelectionEdit.h"
+
+static bool SelectionLess(const Selection &lhs, const Selection &rhs) {
+	return lhs.start() < rhs.start() || (lhs.start() == rhs.start() && lhs.end() < rhs.end());
+}
+
+void SortSelections(std::vector<Selection> &selections) {
+	if (!std::is_sorted(selections.cbegin(), selections.cend(), SelectionLess))
+		std::sort(selections.begin(), selections.end(), SelectionLess);
+}
+
+void MergeSelections(std::vector<Selection> &selections) {
+	SortSelections(selections);
+
+	if (selections.empty())
+		return;
+
+	auto last = selections.begin();
+	for (auto current = selections.begin() + 1; current != selections.end(); ++current) {
+		if (current->start() == last->start() && current->end() == last->end())
+			continue;
+
+		if (last->length() > 0) {
+			const bool overlaps = current->length() > 0 ? current->start() < last->end() : current->start() <= last->end();
+			if (overlaps) {
+				// Grow the selection but keep which way it faces
+				if (current->end() > last->end()) {
+					if (last->caret > last->anchor)
+						last->caret = current->end();
+					else
+						last->anchor = current->end();
+				}
+				continue;
+			}
+		}
+		else if (current->start() == last->start()) {
+			// A caret sorts before the selection starting at the same place
+			*last = *current;
+			continue;
+		}
+
+		*++last = *current;
+	}
+
+	selections.erase(last + 1, selections.end());
+}
+
+void SetCaretsAfterReplacements(const std::vector<Replacement> &replacements, std::vector<Selection> &selections) {
+	Sci_Position totalOffset = 0;
+	for (size_t i = 0; i < replacements.size(); ++i) {
+		const Replacement &replacement = replacements[i];
+
+		selections[i].set(replacement.start + totalOffset + replacement.length);
+		totalOffset += replacement.length - (replacement.end - replacement.start);
+	}
+
+	MergeSelections(selections);
+}
@@ -0,0 +1,308 @@
+// This file is part of BetterMultiSelection.
+// 
+// Copyright (C)2017 Justin Dailey <dail8859@yahoo.com>
+// 
+// BetterMultiSelection is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+#pragma once
+
+#include <cstdlib>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Scintilla.h"
+#include "SelectionSet.h"
+
+// Replacing the text of lots of selections in one sweep. Working out what to
+// replace is done here without Scintilla, and anything that does need it goes
+// through an editor with the same methods as PositionEditor, so the tests can
+// use a document kept in memory instead.
+
+// Describes replacing the text from start to end with the given text
+struct Replacement {
+	Sci_Position start;
+	Sci_Position end;
+	const char *text;
+	Sci_Position length;
+};
+
+// Edits usually keep the selections in order so checking first is cheaper
+void SortSelections(std::vector<Selection> &selections);
+
+// Sorts the selections then combines any that overlap into one, in place in a
+// single pass. Duplicates are removed, a caret inside or touching a selection
+// is dropped, and overlapping selections are united keeping the direction of
+// the first. Selections that only touch each other are kept apart.
+void MergeSelections(std::vector<Selection> &selections);
+
+// Merges the selections and asks replace for the replacement of each one.
+// Returns false as soon as replace can't work out a replacement, or when one
+// found from the text around a caret (e.g. the word before it) reaches into the
+// one before it. Run caret by caret, that caret would see the text already
+// changed and could go further, so the batch can't tell what it would do.
+// Otherwise text can still only be replaced once, so a replacement overlapping
+// the one before it is cut down to start where that one ends.
+template<typename T>
+bool GetReplacements(std::vector<Selection> &selections, T replace, std::vector<Replacement> &replacements) {
+	MergeSelections(selections);
+
+	replacements.clear();
+	Sci_Position previousEnd = 0;
+	Sci_Position changedEnd = -1; // Where the last replacement that changes anything ends
+	for (const auto &selection : selections) {
+		Replacement replacement;
+		if (!replace(selection, replacement))
+			return false;
+
+		const bool lookedBack = replacement.start < selection.start();
+		const bool lookedAhead = replacement.end > selection.end();
+		if ((lookedBack || lookedAhead) && replacement.start < previousEnd)
+			return false;
+		if (lookedBack && replacement.start == changedEnd)
+			return false;
+
+		replacement.start = (replacement.start > previousEnd) ? replacement.start : previousEnd;
+		replacement.end = (replacement.end > replacement.start) ? replacement.end : replacement.start;
+		previousEnd = replacement.end;
+		if (replacement.end > replacement.start || replacement.length > 0)
+			changedEnd = replacement.end;
+
+		replacements.push_back(replacement);
+	}
+
+	return true;
+}
+
+// Puts a caret after the new text of each replacement, in positions of the
+// document once all of them are made, and merges the carets that end up in
+// the same place
+void SetCaretsAfterReplacements(const std::vector<Replacement> &replacements, std::vector<Selection> &selections);
+
+// Replacements further apart than this many bytes of unchanged text are never
+// grouped. Undo keeps a grouped region twice, once as deleted and once as
+// inserted, so even short gaps of unchanged text cost more memory than the edits
+// they replace and only carets on the same or nearby lines are worth it.
+static const Sci_Position maxGroupGap = 32;
+
+// Replacing the unchanged text between replacements throws away whatever
+// Scintilla keeps alongside it. Indicators (Mark All, smart highlighting, spell
+// checking) are cleared from it. Deleting the lines it spans moves their markers
+// (bookmarks, etc) up to the first line and drops their annotations and margin
+// text.
+template<typename Editor>
+bool KeepsStateWithin(const Editor &editor, Sci_Position start, Sci_Position end) {
+	for (int indicator = 0; indicator <= INDICATOR_MAX; ++indicator) {
+		if (editor.IndicatorValueAt(indicator, start) != 0)
+			return true;
+
+		const Sci_Position runEnd = editor.IndicatorEnd(indicator, start);
+		if (runEnd > start && runEnd < end)
+			return true;
+	}
+
+	const Sci_Position firstLine = editor.LineFromPosition(start);
+	const Sci_Position lastLine = editor.LineFromPosition(end);
+	if (lastLine == firstLine)
+		return false;
+
+	const Sci_Position markerLine = editor.MarkerNext(firstLine + 1, ~0);
+	if (markerLine != -1 && markerLine <= lastLine)
+		return true;
+
+	for (Sci_Position line = firstLine; line <= lastLine; ++line) {
+		if (editor.AnnotationGetLines(line) > 0 || editor.MarginGetText(line, nullptr) > 0)
+			return true;
+	}
+
+	return false;
+}
+
+// Lots of replacements close to each other (e.g. a column of carets) are
+// combined into one replacement of the whole region, rebuilt from the new text
+// and the unchanged text in between. Scintilla then makes one change and sends
+// one notification instead of one for each replacement, though the undo entry
+// is not any smaller. It pays off when the unchanged text that has to be copied
+// costs less than the edits that are saved, as long as nothing is kept on that
+// text that the replacement would lose. Folded lines would be unfolded so
+// nothing is grouped while any are hidden. The text of the combined
+// replacements is kept in buffer.
+template<typename Editor>
+void GroupReplacements(Editor &editor, const std::vector<Replacement> &replacements, long long editCost, std::vector<Replacement> &grouped, std::string &buffer) {
+	static std::vector<std::pair<size_t, size_t>> groupTexts; // Index of the grouped replacement and where its text starts in the buffer
+
+	grouped.clear();
+	groupTexts.clear();
+	buffer.clear();
+
+	if (!editor.GetAllLinesVisible()) {
+		grouped = replacements;
+		return;
+	}
+
+	size_t first = 0;
+	while (first < replacements.size()) {
+		size_t last = first;
+		while (last + 1 < replacements.size() && replacements[last + 1].start - replacements[last].end <= maxGroupGap)
+			++last;
+
+		const Sci_Position start = replacements[first].start;
+		const Sci_Position end = replacements[last].end;
+		const long long editsSaved = static_cast<long long>(last - first) * editCost;
+
+		if (editsSaved > end - start && !KeepsStateWithin(editor, start, end)) {
+			const char *original = editor.GetRangePointer(start, end - start);
+			const size_t offset = buffer.size();
+
+			for (size_t i = first; i <= last; ++i) {
+				buffer.append(replacements[i].text, replacements[i].length);
+				if (i < last)
+					buffer.append(original + (replacements[i].end - start), replacements[i + 1].start - replacements[i].end);
+			}
+
+			groupTexts.emplace_back(grouped.size(), offset);
+			grouped.push_back(Replacement{ start, end, nullptr, static_cast<Sci_Position>(buffer.size() - offset) });
+		}
+		else {
+			grouped.insert(grouped.end(), replacements.cbegin() + first, replacements.cbegin() + last + 1);
+		}
+
+		first = last + 1;
+	}
+
+	// The buffer is done growing so it is safe to point into it now
+	for (const auto &groupText : groupTexts)
+		grouped[groupText.first].text = buffer.data() + groupText.second;
+}
+
+// Makes the replacements as a single undo action. The selections are cleared
+// first, otherwise Scintilla moves every one of them for every replacement.
+template<typename Editor>
+void ReplaceText(Editor &editor, const std::vector<Replacement> &replacements, long long editCost) {
+	// Kept between calls so their memory gets reused
+	static std::vector<Replacement> edits;
+	static std::string groupedText;
+
+	if (replacements.empty())
+		return;
+
+	editor.ClearSelections();
+
+	GroupReplacements(editor, replacements, editCost, edits, groupedText);
+
+	editor.BeginUndoAction();
+
+	// Scintilla keeps the text in a gap buffer and every replacement moves the
+	// gap to it. Either way the gap has to travel between the first and last
+	// replacement, so start from whichever end of the batch it is closer to.
+	// Going back to front nothing before a replacement has moved yet.
+	const Sci_Position gap = editor.GetGapPosition();
+	if (std::abs(gap - edits.back().end) < std::abs(gap - edits.front().start)) {
+		for (auto replacement = edits.crbegin(); replacement != edits.crend(); ++replacement) {
+			if (replacement->start == replacement->end && replacement->length == 0)
+				continue;
+
+			editor.SetTargetRange(replacement->start, replacement->end);
+			editor.ReplaceTarget(replacement->length, replacement->text);
+		}
+	}
+	else {
+		Sci_Position totalOffset = 0;
+		for (const auto &replacement : edits) {
+			if (replacement.start == replacement.end && replacement.length == 0)
+				continue;
+
+			editor.SetTargetRange(replacement.start + totalOffset, replacement.end + totalOffset);
+			editor.ReplaceTarget(replacement.length, replacement.text);
+			totalOffset += replacement.length - (replacement.end - replacement.start);
+		}
+	}
+
+	editor.EndUndoAction();
+}
+
+// The selections are otherwise left marked as rectangular, which changes how
+// Scintilla copies, pastes and extends them. Switching the mode also toggles
+// whether caret moves extend the selection, as it does when picked from the
+// menu, so it is set a second time if that is no longer what it was.
+template<typename Editor>
+void ResetToStreamSelection(Editor &editor, bool moveExtends) {
+	editor.SetSelectionMode(SC_SEL_STREAM);
+	if (editor.GetMoveExtendsSelection() != moveExtends)
+		editor.SetSelectionMode(SC_SEL_STREAM);
+}
+
+// Each selection added with AddSelection is checked against every one already
+// there, so restoring lots of them that way grows quadratically. From this many
+// on, a rectangular selection is used as a scaffold instead. Scintilla lays out
+// every line the rectangle covers, which costs about as much per line as a
+// thousand of those checks.
+static const size_t minScaffoldSelections = 1000;
+
+// Scintilla makes one empty selection per line of a rectangle without checking
+// them against each other. Once it is turned back into a stream selection they
+// can each be moved to where they belong in constant time. Setting either end
+// of a rectangle when there isn't one starts it from the beginning of the
+// document, which would lay out every line before it as well, so the mode is
+// switched first to make the main selection the rectangle. The rectangle needs
+// as many lines as there are selections. Returns false if it doesn't work out.
+template<typename Editor>
+bool SetSelectionsWithScaffold(Editor &editor, const std::vector<Selection> &selections) {
+	const Sci_Position count = static_cast<Sci_Position>(selections.size());
+	const Sci_Position lineCount = editor.GetLineCount();
+	if (count < 2 || count > lineCount)
+		return false;
+
+	// Start at the first selection's line to lay out the lines around them
+	Sci_Position firstLine = editor.LineFromPosition(selections.front().start());
+	if (firstLine > lineCount - count)
+		firstLine = lineCount - count;
+	const Sci_Position first = editor.PositionFromLine(firstLine);
+	const Sci_Position last = editor.PositionFromLine(firstLine + count - 1);
+
+	const bool moveExtends = editor.GetMoveExtendsSelection();
+	editor.SetSelection(first, first);
+	editor.SetSelectionMode(SC_SEL_RECTANGLE);
+	editor.SetRectangularSelectionAnchor(first);
+	editor.SetRectangularSelectionCaret(last);
+	ResetToStreamSelection(editor, moveExtends);
+
+	if (editor.GetSelections() != count)
+		return false;
+
+	for (int i = 0; i < count; ++i) {
+		editor.SetSelectionNAnchor(i, selections[i].anchor);
+		editor.SetSelectionNCaret(i, selections[i].caret);
+	}
+
+	// The same one AddSelection would have left as the main selection
+	editor.SetMainSelection(static_cast<int>(count - 1));
+
+	return true;
+}
+
+// Replaces Scintilla's selections with the merged selections
+template<typename Editor>
+void RestoreSelections(Editor &editor, const std::vector<Selection> &selections) {
+	if (selections.size() >= minScaffoldSelections && SetSelectionsWithScaffold(editor, selections))
+		return;
+
+	for (size_t i = 0; i < selections.size(); ++i) {
+		if (i == 0)
+			editor.SetSelection(selections[i].caret, selections[i].anchor);
+		else
+			editor.AddSelection(selections[i].caret, selections[i].anchor);
+	}
+}
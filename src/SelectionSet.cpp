@@ -0,0 +1,86 @@
+// This file is part of BetterMultiSelection.
+// 
+// Copyright (C)2017 Justin Dailey <dail8859@yahoo.com>
+// 
+// BetterMultiSelection is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+
+#include "SelectionSet.h"
+
+void SelectionSet::Assign(const std::vector<Selection> &selections) {
+	const size_t n = selections.size();
+	starts.resize(n);
+	ends.resize(n);
+	caretAtStart.resize(n);
+
+	for (size_t i = 0; i < n; ++i) {
+		starts[i] = selections[i].start();
+		ends[i] = selections[i].end();
+		caretAtStart[i] = selections[i].caret < selections[i].anchor;
+	}
+}
+
+void SelectionSet::CopyTo(std::vector<Selection> &selections) const {
+	selections.clear();
+
+	for (size_t i = 0; i < size(); ++i)
+		selections.push_back((*this)[i]);
+}
+
+bool SelectionSet::Contains(Sci_Position first, Sci_Position second) const {
+	const size_t n = size();
+	for (size_t i = 0; i < n; ++i) {
+		if (starts[i] == first || ends[i] == first || starts[i] == second || ends[i] == second)
+			return true;
+	}
+
+	return false;
+}
+
+bool SelectionSet::InsertText(Sci_Position position, Sci_Position length) {
+	if (Contains(position, position))
+		return false;
+
+	const size_t n = size();
+	for (size_t i = 0; i < n; ++i) {
+		if (starts[i] > position)
+			starts[i] += length;
+		if (ends[i] > position)
+			ends[i] += length;
+	}
+
+	return true;
+}
+
+bool SelectionSet::DeleteText(Sci_Position position, Sci_Position length) {
+	const Sci_Position endDeletion = position + length;
+	if (Contains(position, endDeletion))
+		return false;
+
+	const size_t n = size();
+	for (size_t i = 0; i < n; ++i) {
+		if (starts[i] > endDeletion)
+			starts[i] -= length;
+		else if (starts[i] > position)
+			starts[i] = position;
+
+		if (ends[i] > endDeletion)
+			ends[i] -= length;
+		else if (ends[i] > position)
+			ends[i] = position;
+	}
+
+	return true;
+}
@@ -0,0 +1,78 @@
+// This file is part of BetterMultiSelection.
+// 
+// Copyright (C)2017 Justin Dailey <dail8859@yahoo.com>
+// 
+// BetterMultiSelection is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Sci_Position.h"
+
+struct Selection {
+	Sci_Position caret;
+	Sci_Position anchor;
+
+	Selection(Sci_Position caret, Sci_Position anchor) : caret(caret), anchor(anchor) {}
+
+	Sci_Position start() const { return caret < anchor ? caret : anchor; }
+	Sci_Position end() const { return caret < anchor ? anchor : caret; }
+	Sci_Position length() const { return end() - start(); }
+	void set(Sci_Position pos) { anchor = caret = pos; }
+	void offset(Sci_Position offset) { anchor += offset; caret += offset; }
+};
+
+// Keeps lots of selections as separate arrays of starts, ends, and which side
+// the caret is on. Positions can then be adjusted for an insertion or deletion
+// several at a time instead of one selection after another.
+class SelectionSet final {
+private:
+	std::vector<Sci_Position> starts;
+	std::vector<Sci_Position> ends;
+	std::vector<unsigned char> caretAtStart;
+
+	// Whether any selection starts or ends at either position
+	bool Contains(Sci_Position first, Sci_Position second) const;
+
+public:
+	size_t size() const { return starts.size(); }
+	bool empty() const { return starts.empty(); }
+
+	Selection operator[](size_t i) const {
+		return caretAtStart[i] ? Selection(starts[i], ends[i]) : Selection(ends[i], starts[i]);
+	}
+
+	Selection front() const { return (*this)[0]; }
+	Selection back() const { return (*this)[size() - 1]; }
+
+	void Assign(const std::vector<Selection> &selections);
+	void CopyTo(std::vector<Selection> &selections) const;
+
+	// Moves the positions the same way Scintilla moves its selections when
+	// text is inserted. Returns false without changing anything if a position
+	// is exactly where the text went, since Scintilla may or may not move it.
+	bool InsertText(Sci_Position position, Sci_Position length);
+
+	// Moves the positions the same way Scintilla moves its selections when
+	// text is deleted. Positions inside the deleted text end up at its start.
+	// Returns false without changing anything if a position is at either end
+	// of the deleted text, which usually means Scintilla is editing at that
+	// selection and will set it itself.
+	bool DeleteText(Sci_Position position, Sci_Position length);
+};
@@ -0,0 +1,113 @@
+// This file is part of BetterMultiSelection.
+// 
+// Copyright (C)2017 Justin Dailey <dail8859@yahoo.com>
+// 
+// BetterMultiSelection is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+
+#pragma once
+
+#include <vector>
+
+#include "SelectionSet.h"
+
+// The selections as the plugin last saw them, in the same order as Scintilla
+// has them. Asking Scintilla for every caret on each key press adds up with lots
+// of them, so this gets reused as long as nothing else has touched the selections.
+//
+// Text changed by anyone else has to be passed on to Update, from every view of
+// the document, since that moves the selections without anything else to tell.
+// Changing the selections with the mouse or with keys handled by Scintilla
+// itself almost always changes the number of selections, the first or last one,
+// or the main one, so Matches checks those and a few spread out in between
+// rather than asking for all of them.
+class ShadowSelections final {
+private:
+	SelectionSet selections;
+	bool valid = false;
+
+	template<typename Editor>
+	bool Same(const Editor &editor, size_t n) const {
+		const Selection selection = selections[n];
+		const int i = static_cast<int>(n);
+		return editor.GetSelectionNCaret(i) == selection.caret && editor.GetSelectionNAnchor(i) == selection.anchor;
+	}
+
+public:
+	// How many selections between the first and last one Matches compares
+	static const size_t samples = 8;
+
+	bool Valid() const { return valid; }
+	size_t size() const { return selections.size(); }
+
+	void Invalidate() {
+		valid = false;
+	}
+
+	void Set(const std::vector<Selection> &current) {
+		selections.Assign(current);
+		valid = true;
+	}
+
+	void CopyTo(std::vector<Selection> &current) const {
+		selections.CopyTo(current);
+	}
+
+	// Moves the selections along with text inserted or deleted by someone else,
+	// or gives up on them when it can't tell where Scintilla puts them
+	void Update(bool insertion, Sci_Position position, Sci_Position length) {
+		if (!valid)
+			return;
+
+		valid = insertion ? selections.InsertText(position, length) : selections.DeleteText(position, length);
+	}
+
+	template<typename Editor>
+	bool Matches(const Editor &editor) const {
+		if (!valid)
+			return false;
+
+		const int num = editor.GetSelections();
+		if (num == 0 || static_cast<size_t>(num) != selections.size())
+			return false;
+
+		const int main = editor.GetMainSelection();
+		if (main < 0 || main >= num || !Same(editor, main))
+			return false;
+
+		const size_t last = selections.size() - 1;
+		for (size_t sample = 0; sample <= samples + 1; ++sample) {
+			if (!Same(editor, last * sample / (samples + 1)))
+				return false;
+		}
+
+		return true;
+	}
+
+	// Compares every selection, which is what Matches saves having to do
+	template<typename Editor>
+	bool Equals(const Editor &editor) const {
+		const int num = editor.GetSelections();
+		if (static_cast<size_t>(num) != selections.size())
+			return false;
+
+		for (int i = 0; i < num; ++i) {
+			if (!Same(editor, i))
+				return false;
+		}
+
+		return true;
+	}
+};
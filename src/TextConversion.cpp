@@ -0,0 +1,265 @@
+// This file is part of BetterMultiSelection.
+// 
+// Copyright (C)2017 Justin Dailey <dail8859@yahoo.com>
+// 
+// BetterMultiSelection is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+
+// Widening ASCII a block at a time needs wchar_t to be UTF-16 as on Windows
+#if !defined(SCALAR_ONLY) && (defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || (defined(__SSE2__) && __WCHAR_MAX__ <= 0xFFFF))
+#include <emmintrin.h>
+#define TEXT_CONVERSION_SSE2
+#endif
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "TextConversion.h"
+#include "UniConversion.h"
+
+#ifdef TEXT_CONVERSION_SSE2
+static bool IsAsciiBlock(const char *s) {
+	const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s));
+	return _mm_movemask_epi8(bytes) == 0;
+}
+#endif
+
+size_t UTF16LengthOfUTF8(const char *s, size_t len) {
+	size_t ulen = 0;
+	size_t i = 0;
+	while (i < len) {
+#ifdef TEXT_CONVERSION_SSE2
+		if (len - i >= 16 && IsAsciiBlock(s + i)) {
+			i += 16;
+			ulen += 16;
+			continue;
+		}
+#endif
+
+		// One character at a time the same as UTF16Length()
+		const unsigned int byteCount = UTF8BytesOfLead[static_cast<unsigned char>(s[i])];
+		i += byteCount;
+		ulen += (i > len) ? 1 : UTF16LengthFromUTF8ByteCount(byteCount);
+	}
+	return ulen;
+}
+
+wchar_t *AppendUTF16FromUTF8(const char *s, size_t len, wchar_t *out) {
+#ifdef TEXT_CONVERSION_SSE2
+	const __m128i zero = _mm_setzero_si128();
+#endif
+
+	size_t i = 0;
+	while (i < len) {
+#ifdef TEXT_CONVERSION_SSE2
+		if (len - i >= 16) {
+			const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + i));
+			if (_mm_movemask_epi8(bytes) == 0) {
+				// Widening each byte with a zero byte makes it UTF-16
+				_mm_storeu_si128(reinterpret_cast<__m128i *>(out), _mm_unpacklo_epi8(bytes, zero));
+				_mm_storeu_si128(reinterpret_cast<__m128i *>(out + 8), _mm_unpackhi_epi8(bytes, zero));
+				i += 16;
+				out += 16;
+				continue;
+			}
+		}
+#endif
+
+		// One character at a time the same as UTF16FromUTF8()
+		const unsigned char ch = static_cast<unsigned char>(s[i]);
+		const unsigned int byteCount = UTF8BytesOfLead[ch];
+		if (i + byteCount > len) {
+			*out++ = ch;
+			break;
+		}
+
+		const unsigned char *us = reinterpret_cast<const unsigned char *>(s + i);
+		i += byteCount;
+		switch (byteCount) {
+		case 1:
+			*out++ = ch;
+			break;
+		case 2:
+			*out++ = static_cast<wchar_t>(((ch & 0x1F) << 6) + (us[1] & 0x3F));
+			break;
+		case 3:
+			*out++ = static_cast<wchar_t>(((ch & 0xF) << 12) + ((us[1] & 0x3F) << 6) + (us[2] & 0x3F));
+			break;
+		default: {
+			// Outside the BMP so need two surrogates
+			const unsigned int value = ((ch & 0x7) << 18) + ((us[1] & 0x3F) << 12) + ((us[2] & 0x3F) << 6) + (us[3] & 0x3F);
+			*out++ = static_cast<wchar_t>(((value - 0x10000) >> 10) + SURROGATE_LEAD_FIRST);
+			*out++ = static_cast<wchar_t>((value & 0x3ff) + SURROGATE_TRAIL_FIRST);
+			break;
+		}
+		}
+	}
+	return out;
+}
+
+static bool IsLineEnd(unsigned int ch) {
+	return ch == '\r' || ch == '\n';
+}
+
+void SplitLines(const char *s, size_t len, bool convertLineEnds, const char *eol, std::vector<TextLine> &lines) {
+	lines.clear();
+
+	if (convertLineEnds) {
+		size_t start = 0;
+		for (size_t i = 0; i <= len; ++i) {
+			if (i == len || IsLineEnd(static_cast<unsigned char>(s[i]))) {
+				if (i > start)
+					lines.push_back(TextLine{ s + start, i - start });
+				start = i + 1;
+			}
+		}
+		return;
+	}
+
+	// Any run of characters from eol is skipped before a line starts, but a
+	// line only ends at eol itself
+	const size_t eolLength = strlen(eol);
+	size_t i = 0;
+	while (i < len) {
+		if (memchr(eol, s[i], eolLength) != nullptr) {
+			++i;
+			continue;
+		}
+
+		size_t end = i;
+		while (end < len && !(s[end] == eol[0] && len - end >= eolLength && memcmp(s + end, eol, eolLength) == 0))
+			++end;
+
+		lines.push_back(TextLine{ s + i, end - i });
+		i = end;
+	}
+}
+
+// Same results as UTF8Length() but also finds where the text ends
+static size_t UTF8LengthOfUTF16(const wchar_t *uptr, size_t &tlen) {
+	size_t len = 0;
+	size_t i = 0;
+	while (i < tlen && uptr[i]) {
+		const unsigned int uch = uptr[i];
+		if (uch < 0x80) {
+			len++;
+		}
+		else if (uch < 0x800) {
+			len += 2;
+		}
+		else if (uch >= SURROGATE_LEAD_FIRST && uch <= SURROGATE_TRAIL_LAST) {
+			// The other half of the pair, unless the text ends first
+			len += 4;
+			if (i + 1 < tlen && uptr[i + 1])
+				i++;
+		}
+		else {
+			len += 3;
+		}
+		i++;
+	}
+	tlen = (i < tlen) ? i : tlen;
+	return len;
+}
+
+// Same as UTF8FromUTF16() for the character at i, which moves past it
+static char *AppendUTF8(const wchar_t *uptr, size_t tlen, size_t &i, char *out) {
+	const unsigned int uch = uptr[i++];
+	if (uch < 0x80) {
+		*out++ = static_cast<char>(uch);
+	}
+	else if (uch < 0x800) {
+		*out++ = static_cast<char>(0xC0 | (uch >> 6));
+		*out++ = static_cast<char>(0x80 | (uch & 0x3f));
+	}
+	else if (uch >= SURROGATE_LEAD_FIRST && uch <= SURROGATE_TRAIL_LAST) {
+		// Half a surrogate pair, missing its other half at the very end
+		const unsigned int other = (i < tlen) ? uptr[i] : 0;
+		i++;
+		const unsigned int xch = 0x10000 + ((uch & 0x3ff) << 10) + (other & 0x3ff);
+		*out++ = static_cast<char>(0xF0 | (xch >> 18));
+		*out++ = static_cast<char>(0x80 | ((xch >> 12) & 0x3f));
+		*out++ = static_cast<char>(0x80 | ((xch >> 6) & 0x3f));
+		*out++ = static_cast<char>(0x80 | (xch & 0x3f));
+	}
+	else {
+		*out++ = static_cast<char>(0xE0 | (uch >> 12));
+		*out++ = static_cast<char>(0x80 | ((uch >> 6) & 0x3f));
+		*out++ = static_cast<char>(0x80 | (uch & 0x3f));
+	}
+	return out;
+}
+
+void UTF8LinesFromUTF16(const wchar_t *uptr, size_t tlen, bool convertLineEnds, const char *eol, std::string &buffer, std::vector<TextLine> &lines) {
+	lines.clear();
+
+	const size_t len = UTF8LengthOfUTF16(uptr, tlen);
+	buffer.resize(len);
+	if (len == 0)
+		return;
+
+	char *const begin = &buffer[0];
+	char *out = begin;
+
+	if (!convertLineEnds) {
+		for (size_t i = 0; i < tlen;)
+			out = AppendUTF8(uptr, tlen, i, out);
+		SplitLines(begin, out - begin, false, eol, lines);
+		return;
+	}
+
+#ifdef TEXT_CONVERSION_SSE2
+	const __m128i asciiMask = _mm_set1_epi16(static_cast<short>(0xFF80));
+	const __m128i cr = _mm_set1_epi16('\r');
+	const __m128i lf = _mm_set1_epi16('\n');
+#endif
+
+	char *lineStart = out;
+	size_t i = 0;
+	while (i < tlen) {
+#ifdef TEXT_CONVERSION_SSE2
+		// Eight ASCII characters that aren't line ends get narrowed at once
+		if (tlen - i >= 8) {
+			const __m128i units = _mm_loadu_si128(reinterpret_cast<const __m128i *>(uptr + i));
+			const __m128i ascii = _mm_cmpeq_epi16(_mm_and_si128(units, asciiMask), _mm_setzero_si128());
+			const __m128i lineEnds = _mm_or_si128(_mm_cmpeq_epi16(units, cr), _mm_cmpeq_epi16(units, lf));
+			const __m128i plain = _mm_andnot_si128(lineEnds, ascii);
+			if (_mm_movemask_epi8(plain) == 0xFFFF) {
+				_mm_storel_epi64(reinterpret_cast<__m128i *>(out), _mm_packus_epi16(units, units));
+				i += 8;
+				out += 8;
+				continue;
+			}
+		}
+#endif
+
+		if (IsLineEnd(uptr[i])) {
+			if (out > lineStart)
+				lines.push_back(TextLine{ lineStart, static_cast<size_t>(out - lineStart) });
+			i++;
+			lineStart = out;
+			continue;
+		}
+
+		out = AppendUTF8(uptr, tlen, i, out);
+	}
+
+	if (out > lineStart)
+		lines.push_back(TextLine{ lineStart, static_cast<size_t>(out - lineStart) });
+
+	// Shrinking never reallocates so the lines stay valid
+	buffer.resize(out - begin);
+}
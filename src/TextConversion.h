@@ -0,0 +1,46 @@
+// This file is part of BetterMultiSelection.
+// 
+// Copyright (C)2017 Justin Dailey <dail8859@yahoo.com>
+// 
+// BetterMultiSelection is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Give the same results as UTF16Length() and UTF16FromUTF8(), but runs of
+// ASCII, which is what most text is made of, are handled 16 bytes at a time.
+// The output has to have room for UTF16LengthOfUTF8() characters. Returns
+// the end of what was written so ranges can be appended one after another.
+size_t UTF16LengthOfUTF8(const char *s, size_t len);
+wchar_t *AppendUTF16FromUTF8(const char *s, size_t len, wchar_t *out);
+
+// A line of text that lives in some other buffer
+struct TextLine {
+	const char *text;
+	size_t length;
+};
+
+// Splits text into lines the way pasting always has. Empty lines are left out.
+// When line ends are converted any CR or LF ends a line, otherwise only eol
+// does and other line end characters stay in the line.
+void SplitLines(const char *s, size_t len, bool convertLineEnds, const char *eol, std::vector<TextLine> &lines);
+
+// Converts UTF-16 text, up to the first NUL, to UTF-8 in buffer and splits it
+// into lines the same as SplitLines(). When line ends are converted this is
+// done in a single pass and the line ends are never copied.
+void UTF8LinesFromUTF16(const wchar_t *uptr, size_t tlen, bool convertLineEnds, const char *eol, std::string &buffer, std::vector<TextLine> &lines);
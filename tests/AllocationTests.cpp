@@ -0,0 +1,221 @@
+// This file is part of BetterMultiSelection.
+// 
+// Copyright (C)2017 Justin Dailey <dail8859@yahoo.com>
+// 
+// BetterMultiSelection is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "CaretMovement.h"
+#include "CaretSet.h"
+#include "CoalescedModifications.h"
+#include "SelectionEdit.h"
+#include "SelectionSet.h"
+#include "ShadowSelections.h"
+#include "TextConversion.h"
+
+#include "HeadlessEditor.h"
+#include "Testing.h"
+
+// Everything the plugin does on a key press keeps its buffers from the last
+// one, so once they have grown to fit the selections a steady key press
+// shouldn't allocate at all. Every allocation in this program is counted.
+static long allocations = 0;
+
+void *operator new(std::size_t size) {
+	++allocations;
+	if (void *p = std::malloc(size ? size : 1))
+		return p;
+	throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept {
+	std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept {
+	std::free(p);
+}
+
+static void IgnoreNotification(SCNotification &) {
+}
+
+template<typename F>
+static long AllocationsIn(F f) {
+	const long before = allocations;
+	f();
+	return allocations - before;
+}
+
+// The first run grows the buffers, after that there should be nothing left to
+// allocate for input of the same size
+template<typename F>
+static void CheckSteady(const char *what, F f) {
+	f();
+	const long steady = AllocationsIn(f) + AllocationsIn(f);
+	if (steady != 0)
+		std::printf("%s allocated %ld times once warmed up\n", what, steady);
+	CHECK_EQUAL(0, steady);
+}
+
+int main() {
+	std::vector<Selection> column;
+	std::string text;
+	for (Sci_Position line = 0; line < 10000; ++line) {
+		const Sci_Position lineStart = static_cast<Sci_Position>(text.size());
+		text += "    int value = " + std::to_string(line) + ";\r\n";
+		column.emplace_back(lineStart + 4 + line % 3, lineStart + 4);
+	}
+
+	static SelectionSet shadowSelections;
+	static std::vector<Selection> keySelections;
+	CheckSteady("SelectionSet", [&] {
+		shadowSelections.Assign(column);
+		shadowSelections.InsertText(0, 1);
+		shadowSelections.DeleteText(0, 1);
+		shadowSelections.CopyTo(keySelections);
+	});
+
+	static CaretSet verticalSelections;
+	CheckSteady("CaretSet", [&] {
+		verticalSelections.Assign(column);
+		verticalSelections.Equals(column);
+		verticalSelections.CopyTo(keySelections);
+	});
+
+	static std::vector<Sci_Position> lineStarts;
+	CheckSteady("DocumentSnapshot", [&] {
+		DocumentSnapshot doc(text.data(), 0, static_cast<Sci_Position>(text.size()), static_cast<Sci_Position>(text.size()), true);
+		doc.IndexLines(lineStarts);
+	});
+
+	static std::vector<TextLine> lines;
+	CheckSteady("SplitLines", [&] {
+		SplitLines(text.data(), text.size(), true, "\r\n", lines);
+		SplitLines(text.data(), text.size(), false, "\r\n", lines);
+	});
+
+	std::vector<wchar_t> utf16(text.begin(), text.end());
+	utf16.push_back(0);
+	static std::string buffer;
+	CheckSteady("UTF8LinesFromUTF16", [&] {
+		UTF8LinesFromUTF16(utf16.data(), utf16.size(), true, "\r\n", buffer, lines);
+		UTF8LinesFromUTF16(utf16.data(), utf16.size(), false, "\r\n", buffer, lines);
+	});
+
+	// The same steps the plugin takes on a key press, on a document kept in memory
+	HeadlessEditor editor(text);
+	static std::vector<Selection> selections;
+	std::vector<Selection> carets;
+	for (const auto &selection : column)
+		carets.emplace_back(selection.caret, selection.caret);
+
+	CheckSteady("current selections", [&] {
+		editor.SetSelection(column.front().caret, column.front().anchor);
+		editor.AddSelection(column.back().caret, column.back().anchor);
+		selections.clear();
+		for (int i = 0; i < editor.GetSelections(); ++i)
+			selections.emplace_back(editor.GetSelectionNCaret(i), editor.GetSelectionNAnchor(i));
+	});
+
+	static ShadowSelections shadow;
+	CheckSteady("ShadowSelections", [&] {
+		RestoreSelections(editor, column);
+		shadow.Set(column);
+		shadow.Update(true, 0, 1);
+		shadow.Update(false, 0, 1);
+		shadow.Matches(editor);
+		shadow.CopyTo(keySelections);
+	});
+
+	CheckSteady("MergeSelections", [&] {
+		selections.assign(column.crbegin(), column.crend());
+		selections.insert(selections.end(), carets.cbegin(), carets.cend());
+		MergeSelections(selections);
+	});
+
+	// Typing a character at every caret and deleting it again leaves the
+	// document as it was, so every run gets the same input
+	static std::vector<Replacement> replacements;
+	const auto typeAndDelete = [&](long long editCost) {
+		selections = carets;
+		GetReplacements(selections, [](const Selection &selection, Replacement &replacement) {
+			replacement = Replacement{ selection.start(), selection.end(), "x", 1 };
+			return true;
+		}, replacements);
+		ReplaceText(editor, replacements, editCost);
+		SetCaretsAfterReplacements(replacements, selections);
+
+		GetReplacements(selections, [](const Selection &selection, Replacement &replacement) {
+			replacement = Replacement{ selection.caret - 1, selection.caret, "", 0 };
+			return true;
+		}, replacements);
+		ReplaceText(editor, replacements, editCost);
+		SetCaretsAfterReplacements(replacements, selections);
+	};
+	CheckSteady("ReplaceText", [&] { typeAndDelete(0); });
+	CheckSteady("GroupReplacements", [&] { typeAndDelete(1024); });
+
+	CheckSteady("CoalescedModifications", [&] {
+		CoalescedModifications<HeadlessEditor> coalesced(editor, true, IgnoreNotification);
+		coalesced.KeepOriginal(0, editor.GetLength() / 2);
+		editor.SetTargetRange(16, 17);
+		editor.ReplaceTarget(1, "y");
+		coalesced.Add(16, 17, 0);
+	});
+
+	CheckSteady("RestoreSelections", [&] {
+		RestoreSelections(editor, column);
+		selections.assign(column.cbegin(), column.cbegin() + 100);
+		RestoreSelections(editor, selections);
+	});
+
+	// Moving every caret down a line past its end, remembering the columns it couldn't keep.
+	// The two buffers are swapped each time, so both have grown after two moves.
+	static std::vector<std::pair<Sci_Position, Sci_Position>> verticalColumns;
+	static std::vector<std::pair<Sci_Position, Sci_Position>> columns;
+	CheckSteady("vertical movement", [&] {
+		for (int move = 0; move < 2; ++move) {
+			verticalSelections.Assign(column);
+			DocumentSnapshot doc(text.data(), 0, static_cast<Sci_Position>(text.size()), static_cast<Sci_Position>(text.size()), true);
+			doc.IndexLines(lineStarts);
+
+			columns.clear();
+			selections = column;
+			for (auto &selection : selections) {
+				const auto remembered = std::lower_bound(verticalColumns.cbegin(), verticalColumns.cend(), std::make_pair(selection.caret, static_cast<Sci_Position>(INT_MIN)));
+				const Sci_Position caretColumn = (remembered != verticalColumns.cend() && remembered->first == selection.caret) ? remembered->second : doc.Column(selection.caret, 4);
+				const Sci_Position pos = doc.PositionUpOrDown(selection.caret, 1, caretColumn + 32, 4);
+				if (pos == DocumentSnapshot::invalidPosition)
+					continue;
+
+				selection.set(pos);
+				if (doc.Column(pos, 4) != caretColumn + 32)
+					columns.emplace_back(pos, caretColumn + 32);
+			}
+			std::sort(columns.begin(), columns.end());
+			verticalColumns.swap(columns);
+			verticalSelections.Equals(selections);
+		}
+	});
+
+	return TestResult("AllocationTests");
+}
@@ -0,0 +1,60 @@
+// This file is part of BetterMultiSelection.
+// 
+// Copyright (C)2017 Justin Dailey <dail8859@yahoo.com>
+// 
+// BetterMultiSelection is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+// Timing for the benchmark programs. ctest runs each of them with --quick, on
+// small inputs, so they keep building and working. Run them by hand from a
+// release build for the numbers.
+
+typedef std::chrono::steady_clock Clock;
+
+// Each benchmark is built twice, once without any of the SIMD code, so the
+// timings of the two can be put side by side
+#ifdef SCALAR_ONLY
+static const char *const buildName = "scalar";
+#else
+static const char *const buildName = "SIMD";
+#endif
+
+inline bool IsQuickRun(int argc, char *argv[]) {
+	for (int i = 1; i < argc; ++i) {
+		if (std::strcmp(argv[i], "--quick") == 0)
+			return true;
+	}
+	return false;
+}
+
+// Milliseconds for one run of run, the best of several so a stray interruption
+// doesn't count. setup is called before each run and isn't timed.
+template<typename Setup, typename Run>
+double BestTime(int attempts, Setup setup, Run run) {
+	double best = 1e300;
+	for (int attempt = 0; attempt < attempts; ++attempt) {
+		setup();
+		const Clock::time_point start = Clock::now();
+		run();
+		const std::chrono::duration<double, std::milli> elapsed = Clock::now() - start;
+		best = std::min(best, elapsed.count());
+	}
+	return best;
+}
@@ -0,0 +1,157 @@
+// This file is part of BetterMultiSelection.
+// 
+// Copyright (C)2017 Justin Dailey <dail8859@yahoo.com>
+// 
+// BetterMultiSelection is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "CaretMovement.h"
+
+#include "Benchmark.h"
+
+// Each of the movements done in the plugin with a million carets, then Ctrl+Left
+// and Ctrl+Right with a caret on every line of a big CSV file. The scan for the
+// end of a word goes 16 bytes at a time with SSSE3, and a byte at a time in
+// CaretMovementBenchmarkScalar.
+
+// Keeps the results so the work can't be optimized away
+static volatile Sci_Position sink = 0;
+
+// Indented lines of code with some non-ASCII text in the comments
+static std::string Code(size_t lines) {
+	std::string text;
+	for (size_t line = 0; line < lines; ++line) {
+		text += std::string(1 + line % 3, '\t');
+		text += "total += item" + std::to_string(line % 100) + ".price; // na\xC3\xAFve \xE2\x82\xAC " + std::to_string(line) + "\r\n";
+	}
+	return text;
+}
+
+// A caret part way into each line, inside a word or in the comment
+static std::vector<Sci_Position> MiddleCarets(const std::string &text) {
+	std::vector<Sci_Position> carets;
+	Sci_Position lineStart = 0;
+	for (size_t i = 0; i < text.size(); ++i) {
+		if (text[i] == '\n') {
+			const Sci_Position lineLength = static_cast<Sci_Position>(i) - lineStart;
+			carets.push_back(lineStart + lineLength * (1 + carets.size() % 3) / 4);
+			lineStart = static_cast<Sci_Position>(i + 1);
+		}
+	}
+	return carets;
+}
+
+static void MoveEveryCaret(bool quick) {
+	const std::string text = Code(quick ? 10000 : 1000000);
+	const std::vector<Sci_Position> carets = MiddleCarets(text);
+	const Sci_Position length = static_cast<Sci_Position>(text.size());
+
+	std::printf("%zu carets, one on each line\n", carets.size());
+
+	for (const bool utf8 : { true, false }) {
+		CharacterClassifier classifier;
+		if (utf8)
+			classifier.SetUnknownAbove(0x7F);
+		const DocumentSnapshot doc(text.data(), 0, length, length, utf8, &classifier);
+
+		struct Movement {
+			const char *name;
+			Sci_Position(*move)(const DocumentSnapshot &doc, Sci_Position pos);
+		};
+		const Movement movements[] = {
+			{ "char left ", [](const DocumentSnapshot &doc, Sci_Position pos) { return doc.PositionBefore(pos); } },
+			{ "char right", [](const DocumentSnapshot &doc, Sci_Position pos) { return doc.PositionAfter(pos); } },
+			{ "word left ", [](const DocumentSnapshot &doc, Sci_Position pos) { return doc.NextWordStart(pos, -1); } },
+			{ "word right", [](const DocumentSnapshot &doc, Sci_Position pos) { return doc.NextWordStart(pos, 1); } },
+			{ "home      ", [](const DocumentSnapshot &doc, Sci_Position pos) { return doc.VCHomePosition(pos); } },
+			{ "line end  ", [](const DocumentSnapshot &doc, Sci_Position pos) { return doc.LineEndPosition(pos); } },
+		};
+
+		std::printf("  %s\n", utf8 ? "UTF-8" : "code page");
+		for (const Movement &movement : movements) {
+			const double time = BestTime(3, []() {}, [&]() {
+				for (const Sci_Position caret : carets)
+					sink += movement.move(doc, caret);
+			});
+			std::printf("    %s: %8.2f ms, %6.1f million carets/s (%s)\n", movement.name, time, carets.size() / time / 1000.0, buildName);
+		}
+	}
+}
+
+// Rows of short fields, or with a long one in front (e.g. a hash) when given
+static std::string Csv(size_t size, bool longField) {
+	std::string text;
+	text.reserve(size + 256);
+	for (unsigned int row = 0; text.size() < size; ++row) {
+		if (longField) {
+			unsigned int hash = row * 2654435761u;
+			for (int i = 0; i < 8; ++i, hash = hash * 1103515245u + 12345u) {
+				char hex[9];
+				std::snprintf(hex, sizeof(hex), "%08x", hash);
+				text += hex;
+			}
+			text += ',';
+		}
+		text += std::to_string(row) + ",Customer " + std::to_string(row % 997) + ",customer" + std::to_string(row % 997) + "@example.com,2017-05-" + std::to_string(10 + row % 20) + "," + std::to_string(row % 5000) + ".25\r\n";
+	}
+	return text;
+}
+
+// Where each line starts and where its first field ends
+static void Fields(const std::string &text, std::vector<Sci_Position> &lineStarts, std::vector<Sci_Position> &fieldEnds) {
+	lineStarts.assign(1, 0);
+	for (size_t i = 0; i + 1 < text.size(); ++i) {
+		if (text[i] == '\n')
+			lineStarts.push_back(static_cast<Sci_Position>(i + 1));
+	}
+	fieldEnds.clear();
+	for (const Sci_Position lineStart : lineStarts)
+		fieldEnds.push_back(static_cast<Sci_Position>(text.find(',', lineStart)));
+}
+
+int main(int argc, char *argv[]) {
+	const bool quick = IsQuickRun(argc, argv);
+	const size_t size = quick ? (2 << 20) : (200 << 20);
+	const CharacterClassifier classifier;
+
+	MoveEveryCaret(quick);
+
+	for (const bool longField : { false, true }) {
+		const std::string text = Csv(size, longField);
+		std::vector<Sci_Position> lineStarts;
+		std::vector<Sci_Position> fieldEnds;
+		Fields(text, lineStarts, fieldEnds);
+		const Sci_Position length = static_cast<Sci_Position>(text.size());
+		const DocumentSnapshot doc(text.data(), 0, length, length, true, &classifier);
+
+		std::printf("%zu MB of CSV%s, %zu carets\n", text.size() >> 20, longField ? " starting with a long field" : "", lineStarts.size());
+
+		// Word right from the start of each line and word left from the end
+		// of its first field, so both cross the first field
+		for (const int delta : { 1, -1 }) {
+			const std::vector<Sci_Position> &carets = (delta > 0) ? lineStarts : fieldEnds;
+			const double time = BestTime(3, []() {}, [&]() {
+				for (const Sci_Position caret : carets)
+					sink += doc.NextWordStart(caret, delta);
+			});
+			std::printf("  word %s: %8.2f ms (%s)\n", (delta > 0) ? "right" : "left ", time, buildName);
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,409 @@
+// This file is part of BetterMultiSelection.
+// 
+// Copyright (C)2017 Justin Dailey <dail8859@yahoo.com>
+// 
+// BetterMultiSelection is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+
+#include <cctype>
+#include <string>
+#include <vector>
+
+#include "CaretMovement.h"
+#include "UniConversion.h"
+
+#include "Testing.h"
+
+// Straightforward versions of the routines in Scintilla's Document.cxx that
+// DocumentSnapshot has to agree with, working on the whole document a byte at
+// a time.
+class ReferenceDocument final {
+private:
+	const std::string &text;
+	bool utf8;
+
+	Sci_Position Length() const {
+		return static_cast<Sci_Position>(text.size());
+	}
+
+	unsigned char UCharAt(Sci_Position pos) const {
+		return static_cast<unsigned char>(text[pos]);
+	}
+
+	bool IsCrLf(Sci_Position pos) const {
+		return pos >= 0 && pos + 1 < Length() && text[pos] == '\r' && text[pos + 1] == '\n';
+	}
+
+	bool InGoodUTF8(Sci_Position pos, Sci_Position &start, Sci_Position &end) const {
+		Sci_Position trail = pos;
+		while ((trail > 0) && (pos - trail < UTF8MaxBytes) && UTF8IsTrailByte(UCharAt(trail - 1)))
+			trail--;
+		start = (trail > 0) ? trail - 1 : trail;
+
+		const unsigned char leadByte = UCharAt(start);
+		const int widthCharBytes = UTF8BytesOfLead[leadByte];
+		if (widthCharBytes == 1 || pos - start > widthCharBytes - 1)
+			return false;
+
+		unsigned char charBytes[UTF8MaxBytes] = { leadByte, 0, 0, 0 };
+		for (int b = 1; b < widthCharBytes && (start + b) < Length(); b++)
+			charBytes[b] = UCharAt(start + b);
+		if (UTF8Classify(charBytes, widthCharBytes) & UTF8MaskInvalid)
+			return false;
+
+		end = start + widthCharBytes;
+		return true;
+	}
+
+	Sci_Position MovePositionOutsideChar(Sci_Position pos, int moveDir) const {
+		if (pos <= 0)
+			return 0;
+		if (pos >= Length())
+			return Length();
+		if (IsCrLf(pos - 1))
+			return (moveDir > 0) ? pos + 1 : pos - 1;
+		if (utf8 && UTF8IsTrailByte(UCharAt(pos))) {
+			Sci_Position start = pos;
+			Sci_Position end = pos;
+			if (InGoodUTF8(pos, start, end))
+				pos = (moveDir > 0) ? end : start;
+		}
+		return pos;
+	}
+
+	static Sci_Position NextTab(Sci_Position column, int tabWidth) {
+		return ((column / tabWidth) + 1) * tabWidth;
+	}
+
+public:
+	std::vector<Sci_Position> lineStarts;
+
+	ReferenceDocument(const std::string &text, bool utf8) : text(text), utf8(utf8) {
+		lineStarts.push_back(0);
+		for (Sci_Position pos = 0; pos < Length(); pos++) {
+			if (IsCrLf(pos))
+				pos++;
+			if (text[pos] == '\r' || text[pos] == '\n')
+				lineStarts.push_back(pos + 1);
+		}
+	}
+
+	Sci_Position LineFromPosition(Sci_Position pos) const {
+		Sci_Position line = 0;
+		while (line + 1 < static_cast<Sci_Position>(lineStarts.size()) && lineStarts[line + 1] <= pos)
+			line++;
+		return line;
+	}
+
+	Sci_Position LineEnd(Sci_Position line) const {
+		if (line + 1 >= static_cast<Sci_Position>(lineStarts.size()))
+			return Length();
+		Sci_Position end = lineStarts[line + 1] - 1;
+		if (IsCrLf(end - 1))
+			end--;
+		return end;
+	}
+
+	// Scintilla never leaves a caret inside a CRLF or a UTF-8 character
+	bool IsCaretPosition(Sci_Position pos) const {
+		return MovePositionOutsideChar(pos, 1) == pos;
+	}
+
+	Sci_Position PositionBefore(Sci_Position pos) const {
+		return MovePositionOutsideChar(pos - 1, -1);
+	}
+
+	Sci_Position PositionAfter(Sci_Position pos) const {
+		return MovePositionOutsideChar(pos + 1, 1);
+	}
+
+	Sci_Position VCHomePosition(Sci_Position pos) const {
+		const Sci_Position line = LineFromPosition(pos);
+		const Sci_Position startPosition = lineStarts[line];
+		const Sci_Position endLine = LineEnd(line);
+		Sci_Position startText = startPosition;
+		while (startText < endLine && (text[startText] == ' ' || text[startText] == '\t'))
+			startText++;
+		return (pos == startText) ? startPosition : startText;
+	}
+
+	// The classes are looked up one byte at a time, the way Scintilla does for
+	// ASCII text
+	Sci_Position NextWordStart(const CharacterClass *classes, Sci_Position pos, int delta) const {
+		if (delta < 0) {
+			while (pos > 0 && classes[UCharAt(pos - 1)] == ccSpace)
+				pos--;
+			if (pos > 0) {
+				const CharacterClass ccStart = classes[UCharAt(pos - 1)];
+				while (pos > 0 && classes[UCharAt(pos - 1)] == ccStart)
+					pos--;
+			}
+		}
+		else {
+			const CharacterClass ccStart = (pos < Length()) ? classes[UCharAt(pos)] : ccSpace;
+			while (pos < Length() && classes[UCharAt(pos)] == ccStart)
+				pos++;
+			while (pos < Length() && classes[UCharAt(pos)] == ccSpace)
+				pos++;
+		}
+		return pos;
+	}
+
+	Sci_Position NextWordEnd(const CharacterClass *classes, Sci_Position pos, int delta) const {
+		if (delta < 0) {
+			if (pos > 0) {
+				const CharacterClass ccStart = classes[UCharAt(pos - 1)];
+				if (ccStart != ccSpace) {
+					while (pos > 0 && classes[UCharAt(pos - 1)] == ccStart)
+						pos--;
+				}
+				while (pos > 0 && classes[UCharAt(pos - 1)] == ccSpace)
+					pos--;
+			}
+		}
+		else {
+			while (pos < Length() && classes[UCharAt(pos)] == ccSpace)
+				pos++;
+			if (pos < Length()) {
+				const CharacterClass ccStart = classes[UCharAt(pos)];
+				while (pos < Length() && classes[UCharAt(pos)] == ccStart)
+					pos++;
+			}
+		}
+		return pos;
+	}
+
+	Sci_Position GetColumn(Sci_Position pos, int tabWidth) const {
+		Sci_Position column = 0;
+		for (Sci_Position i = lineStarts[LineFromPosition(pos)]; i < pos;) {
+			const char ch = text[i];
+			if (ch == '\t') {
+				column = NextTab(column, tabWidth);
+				i++;
+			}
+			else if (ch == '\r' || ch == '\n') {
+				return column;
+			}
+			else {
+				column++;
+				i = PositionAfter(i);
+			}
+		}
+		return column;
+	}
+
+	Sci_Position FindColumn(Sci_Position line, Sci_Position column, int tabWidth) const {
+		Sci_Position position = lineStarts[line];
+		Sci_Position columnCurrent = 0;
+		while ((columnCurrent < column) && (position < Length())) {
+			const char ch = text[position];
+			if (ch == '\t') {
+				columnCurrent = NextTab(columnCurrent, tabWidth);
+				if (columnCurrent > column)
+					return position;
+				position++;
+			}
+			else if (ch == '\r' || ch == '\n') {
+				return position;
+			}
+			else {
+				columnCurrent++;
+				position = PositionAfter(position);
+			}
+		}
+		return position;
+	}
+};
+
+static bool IsPlainASCII(const std::string &text) {
+	for (const char ch : text) {
+		const unsigned char uch = static_cast<unsigned char>(ch);
+		if (uch != '\t' && uch != '\r' && uch != '\n' && (uch < 0x20 || uch >= 0x7F))
+			return false;
+	}
+	return true;
+}
+
+// A snapshot of part of the document can only give the same answer as the
+// whole document or say it doesn't know. With all of the document it has to
+// know whenever the text is plain ASCII.
+#define CHECK_AGREES(expected, actual, mustKnow) \
+	do { \
+		const Sci_Position answer = (actual); \
+		if (answer == DocumentSnapshot::invalidPosition) \
+			CHECK(!(mustKnow)); \
+		else \
+			CHECK_EQUAL(expected, answer); \
+	} while (0)
+
+static void CheckCharacterMovement(const std::string &text, bool utf8, Sci_Position start, Sci_Position end) {
+	const ReferenceDocument reference(text, utf8);
+	const Sci_Position length = static_cast<Sci_Position>(text.size());
+	const DocumentSnapshot doc(text.data() + start, start, end, length, utf8);
+	const bool whole = start == 0 && end == length;
+
+	for (Sci_Position pos = start; pos <= end; ++pos) {
+		if (!reference.IsCaretPosition(pos))
+			continue;
+
+		CHECK_AGREES(reference.PositionBefore(pos), doc.PositionBefore(pos), whole);
+		CHECK_AGREES(reference.PositionAfter(pos), doc.PositionAfter(pos), whole);
+		CHECK_AGREES(reference.VCHomePosition(pos), doc.VCHomePosition(pos), whole);
+		CHECK_AGREES(reference.LineEnd(reference.LineFromPosition(pos)), doc.LineEndPosition(pos), whole);
+	}
+}
+
+// Scintilla's CharClassify::SetDefaultCharClasses() followed by the word
+// characters a lexer might set
+static void DefaultClasses(CharacterClass *classes, const std::string &wordChars) {
+	for (int ch = 0; ch < 256; ch++) {
+		if (ch == '\r' || ch == '\n')
+			classes[ch] = ccNewLine;
+		else if (ch < 0x20 || ch == ' ')
+			classes[ch] = ccSpace;
+		else if (ch >= 0x80 || isalnum(ch) || ch == '_')
+			classes[ch] = ccWord;
+		else
+			classes[ch] = ccPunctuation;
+	}
+	for (const char ch : wordChars)
+		classes[static_cast<unsigned char>(ch)] = ccWord;
+}
+
+// Long runs of the same class so the block at a time scanning gets used,
+// with the odd short run to end a block part way through
+static std::string RandomRuns(std::mt19937 &random, const std::string &alphabet, size_t runs) {
+	std::uniform_int_distribution<size_t> pick(0, alphabet.size() - 1);
+	std::uniform_int_distribution<size_t> runLength(1, 40);
+	std::string text;
+	for (size_t i = 0; i < runs; ++i)
+		text.append(runLength(random), alphabet[pick(random)]);
+	return text;
+}
+
+static void CheckWordMovement(const std::string &text, bool utf8, Sci_Position start, Sci_Position end) {
+	static const std::string wordChars = "-";
+
+	const ReferenceDocument reference(text, utf8);
+	const Sci_Position length = static_cast<Sci_Position>(text.size());
+	const bool whole = start == 0 && end == length && IsPlainASCII(text);
+
+	CharacterClass classes[256];
+	DefaultClasses(classes, wordChars);
+
+	CharacterClassifier classifier;
+	classifier.SetCharClasses(wordChars.data(), static_cast<int>(wordChars.size()), ccWord);
+	if (utf8)
+		classifier.SetUnknownAbove(0x7F);
+
+	const DocumentSnapshot doc(text.data() + start, start, end, length, utf8, &classifier);
+
+	for (Sci_Position pos = start; pos <= end; ++pos) {
+		if (!reference.IsCaretPosition(pos))
+			continue;
+
+		for (const int delta : { -1, 1 }) {
+			CHECK_AGREES(reference.NextWordStart(classes, pos, delta), doc.NextWordStart(pos, delta), whole);
+			CHECK_AGREES(reference.NextWordEnd(classes, pos, delta), doc.NextWordEnd(pos, delta), whole);
+		}
+	}
+}
+
+// The snapshot has to start at the start of a line for the line index
+static void CheckColumns(const std::string &text, Sci_Position firstLine, Sci_Position lastLine, int tabWidth) {
+	const ReferenceDocument reference(text, true);
+	const Sci_Position length = static_cast<Sci_Position>(text.size());
+	const Sci_Position lineCount = static_cast<Sci_Position>(reference.lineStarts.size());
+	const Sci_Position start = reference.lineStarts[firstLine];
+	const Sci_Position end = (lastLine + 1 < lineCount) ? reference.lineStarts[lastLine + 1] : length;
+	const bool plain = IsPlainASCII(text);
+
+	std::vector<Sci_Position> lineStarts;
+	DocumentSnapshot doc(text.data() + start, start, end, length, true);
+	doc.IndexLines(lineStarts);
+
+	for (Sci_Position pos = start; pos < end || (pos == end && end == length); ++pos) {
+		if (!reference.IsCaretPosition(pos))
+			continue;
+
+		const Sci_Position column = doc.Column(pos, tabWidth);
+		CHECK_AGREES(reference.GetColumn(pos, tabWidth), column, plain);
+		if (column == DocumentSnapshot::invalidPosition)
+			continue;
+
+		// Moving up or down only has to be answered between lines of the snapshot
+		const Sci_Position line = reference.LineFromPosition(pos);
+		for (const int direction : { -1, 1 }) {
+			const Sci_Position target = line + direction;
+			const bool exists = target >= 0 && target < lineCount;
+			const Sci_Position expected = exists ? reference.FindColumn(target, column, tabWidth) : DocumentSnapshot::invalidPosition;
+			CHECK_AGREES(expected, doc.PositionUpOrDown(pos, direction, column, tabWidth), plain && target >= firstLine && target <= lastLine);
+		}
+	}
+}
+
+int main() {
+	std::mt19937 random(4);
+
+	// CR, LF and CRLF line ends, indentation and a couple of UTF-8 characters
+	const std::string plain = "ab \t\r\n";
+	const std::string mixed = "ab \t\r\n\xC3\xA9\xE2\x82\xAC\xF0\x9F\x98\x80\x80";
+
+	for (int trial = 0; trial < 2000; ++trial) {
+		const std::string &alphabet = (trial % 2 == 0) ? plain : mixed;
+		const std::string text = RandomText(random, alphabet, 1 + random() % 80);
+		const Sci_Position length = static_cast<Sci_Position>(text.size());
+
+		const bool utf8 = trial % 4 != 3;
+		CheckCharacterMovement(text, utf8, 0, length);
+
+		std::uniform_int_distribution<Sci_Position> position(0, length);
+		Sci_Position start = position(random);
+		Sci_Position end = position(random);
+		if (start > end)
+			std::swap(start, end);
+		CheckCharacterMovement(text, utf8, start, end);
+
+		const ReferenceDocument reference(text, true);
+		const Sci_Position lineCount = static_cast<Sci_Position>(reference.lineStarts.size());
+		std::uniform_int_distribution<Sci_Position> line(0, lineCount - 1);
+		Sci_Position firstLine = line(random);
+		Sci_Position lastLine = line(random);
+		if (firstLine > lastLine)
+			std::swap(firstLine, lastLine);
+		CheckColumns(text, 0, lineCount - 1, 1 + trial % 8);
+		CheckColumns(text, firstLine, lastLine, 4);
+	}
+
+	const std::string wordAlphabet = "aZ_9-.( \t\r\n";
+	const std::string wordMixed = "aZ_9-.( \t\r\n\xC3\xA9";
+
+	for (int trial = 0; trial < 2000; ++trial) {
+		const std::string text = RandomRuns(random, (trial % 2 == 0) ? wordAlphabet : wordMixed, 1 + random() % 12);
+		const Sci_Position length = static_cast<Sci_Position>(text.size());
+
+		const bool utf8 = trial % 4 != 3;
+		CheckWordMovement(text, utf8, 0, length);
+
+		std::uniform_int_distribution<Sci_Position> position(0, length);
+		Sci_Position start = position(random);
+		Sci_Position end = position(random);
+		if (start > end)
+			std::swap(start, end);
+		CheckWordMovement(text, utf8, start, end);
+	}
+
+	return TestResult("CaretMovementTests");
+}
@@ -0,0 +1,113 @@
+// This file is part of BetterMultiSelection.
+// 
+// Copyright (C)2017 Justin Dailey <dail8859@yahoo.com>
+// 
+// BetterMultiSelection is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "CaretSet.h"
+
+#include "Benchmark.h"
+
+// How much memory a CaretSet takes for a million carets, and how quickly they
+// can be gone through, next to keeping them in a vector of selections.
+
+// Keeps the results so the work can't be optimized away
+static volatile Sci_Position sink = 0;
+
+// Depends on every selection in order, so it can't be worked out from the runs
+static Sci_Position Hash(Sci_Position total, const Selection &selection) {
+	return total * 31 + (selection.caret ^ selection.anchor);
+}
+
+// The same column on lines that are all the same length, as after splitting a
+// rectangular selection into lines
+static std::vector<Selection> SameColumn(size_t count) {
+	std::vector<Selection> selections;
+	for (size_t line = 0; line < count; ++line) {
+		const Sci_Position caret = static_cast<Sci_Position>(line * 42 + 8);
+		selections.emplace_back(caret, caret);
+	}
+	return selections;
+}
+
+// The end of each line, where the lines are all different lengths
+static std::vector<Selection> LineEnds(size_t count) {
+	std::mt19937 random(1);
+	std::vector<Selection> selections;
+	Sci_Position caret = 0;
+	for (size_t line = 0; line < count; ++line) {
+		caret += 2 + static_cast<Sci_Position>(random() % 120);
+		selections.emplace_back(caret, caret);
+	}
+	return selections;
+}
+
+// Each word selected after a search, which could be anywhere in the lines
+static std::vector<Selection> Words(size_t count) {
+	std::mt19937 random(2);
+	std::vector<Selection> selections;
+	Sci_Position start = 0;
+	for (size_t i = 0; i < count; ++i) {
+		start += 8 + static_cast<Sci_Position>(random() % 400);
+		selections.emplace_back(start + 4 + static_cast<Sci_Position>(random() % 12), start);
+	}
+	return selections;
+}
+
+static void Report(const char *name, const std::vector<Selection> &selections) {
+	const double millions = selections.size() / 1e6;
+
+	CaretSet carets;
+	const double assign = BestTime(3, [&]() { carets.clear(); }, [&]() { carets.Assign(selections); });
+
+	std::vector<Selection> copy;
+	copy.reserve(selections.size());
+	const double copyTo = BestTime(3, []() {}, [&]() { carets.CopyTo(copy); });
+
+	const double forEach = BestTime(3, []() {}, [&]() {
+		Sci_Position total = 0;
+		carets.ForEach([&total](const Selection &selection) {
+			total = Hash(total, selection);
+			return true;
+		});
+		sink += total;
+	});
+
+	const double vector = BestTime(3, []() {}, [&]() {
+		Sci_Position total = 0;
+		for (const Selection &selection : selections)
+			total = Hash(total, selection);
+		sink += total;
+	});
+
+	std::printf("  %s: %8.3f MB per million carets (vector %.3f MB)\n", name, carets.MemoryUsed() / millions / 1e6, sizeof(Selection) * 1e6 / 1e6);
+	std::printf("    assign %7.2f ms, copy out %7.2f ms, ForEach %7.1f million carets/s (vector %.1f)\n", assign, copyTo, millions / forEach * 1000.0, millions / vector * 1000.0);
+}
+
+int main(int argc, char *argv[]) {
+	const size_t count = IsQuickRun(argc, argv) ? 10000 : 5000000;
+
+	std::printf("%zu selections\n", count);
+	Report("same column", SameColumn(count));
+	Report("line ends  ", LineEnds(count));
+	Report("words      ", Words(count));
+
+	return 0;
+}
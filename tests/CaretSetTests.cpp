@@ -0,0 +1,96 @@
+// This file is part of BetterMultiSelection.
+// 
+// Copyright (C)2017 Justin Dailey <dail8859@yahoo.com>
+// 
+// BetterMultiSelection is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+
+#include <vector>
+
+#include "CaretSet.h"
+
+#include "Testing.h"
+
+static void CheckRoundTrip(const std::vector<Selection> &selections) {
+	CaretSet set;
+	set.Assign(selections);
+	CHECK_EQUAL(selections.size(), set.size());
+	CHECK(set.Equals(selections));
+
+	std::vector<Selection> copied;
+	set.CopyTo(copied);
+	CHECK_EQUAL(selections.size(), copied.size());
+	for (size_t i = 0; i < selections.size() && i < copied.size(); ++i) {
+		CHECK_EQUAL(selections[i].caret, copied[i].caret);
+		CHECK_EQUAL(selections[i].anchor, copied[i].anchor);
+	}
+
+	// Any single difference has to be noticed, wherever it is
+	if (!selections.empty()) {
+		std::vector<Selection> changed = selections;
+		changed[changed.size() / 2].anchor++;
+		CHECK(!set.Equals(changed));
+
+		changed = selections;
+		changed.back().caret--;
+		CHECK(!set.Equals(changed));
+
+		changed = selections;
+		changed.pop_back();
+		CHECK(!set.Equals(changed));
+	}
+}
+
+int main() {
+	std::mt19937 random(16);
+
+	CheckRoundTrip({});
+
+	// Anything at all, including unsorted, reversed and far apart positions
+	for (int trial = 0; trial < 5000; ++trial) {
+		std::uniform_int_distribution<Sci_Position> position(0, (trial % 2 == 0) ? 100 : PTRDIFF_MAX / 2);
+		std::vector<Selection> selections;
+		const size_t count = random() % 20;
+		for (size_t i = 0; i < count; ++i) {
+			const Sci_Position caret = position(random);
+			selections.emplace_back(caret, (random() % 3 == 0) ? position(random) : caret);
+		}
+		CheckRoundTrip(selections);
+	}
+
+	// A column of a million carets over lines of the same length is a single
+	// run, and lines of slightly different lengths still only take a few bytes
+	// per caret
+	std::vector<Selection> column;
+	for (Sci_Position line = 0; line < 1000000; ++line)
+		column.emplace_back(line * 81 + 10, line * 81 + 14);
+	CheckRoundTrip(column);
+
+	CaretSet set;
+	set.Assign(column);
+	CHECK(set.MemoryUsed() < 64);
+
+	std::vector<Selection> ragged;
+	Sci_Position lineStart = 0;
+	for (Sci_Position line = 0; line < 1000000; ++line) {
+		ragged.emplace_back(lineStart + 10, lineStart + 10);
+		lineStart += 60 + random() % 40;
+	}
+	CheckRoundTrip(ragged);
+	set.Assign(ragged);
+	CHECK(set.MemoryUsed() < ragged.size() * sizeof(Selection) / 2);
+
+	return TestResult("CaretSetTests");
+}
@@ -0,0 +1,154 @@
+// This file is part of BetterMultiSelection.
+// 
+// Copyright (C)2017 Justin Dailey <dail8859@yahoo.com>
+// 
+// BetterMultiSelection is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "CoalescedModifications.h"
+#include "SelectionEdit.h"
+
+#include "HeadlessEditor.h"
+#include "Testing.h"
+
+// Counts the SCN_MODIFIED notifications other plugins get for one key press,
+// and checks that replaying what they were told gives the document as it is.
+
+static HeadlessEditor *notified = nullptr;
+
+static void NotifyEditor(SCNotification &scn) {
+	notified->Notify(scn);
+}
+
+// Applies the insertions and deletions to the text as it was before. Each
+// deletion has to say what text it deleted.
+static std::string Replay(std::string text, const std::vector<HeadlessEditor::Modification> &modifications) {
+	for (const auto &modification : modifications) {
+		if (modification.type & SC_MOD_INSERTTEXT) {
+			CHECK(modification.hasText);
+			text.insert(modification.position, modification.text);
+		}
+		else if (modification.type & SC_MOD_DELETETEXT) {
+			CHECK(modification.hasText);
+			CHECK(text.compare(modification.position, modification.length, modification.text) == 0);
+			text.erase(modification.position, modification.length);
+		}
+	}
+	return text;
+}
+
+static const char *const texts[] = { "", "x", "pasted", "two\r\nlines", "\r\n" };
+
+// The same steps as ReplaceSelections in the plugin, replacing each selection
+// with one of the texts, or with the one given
+static void ReplaceSelections(HeadlessEditor &editor, std::vector<Selection> &selections, bool coalesce, long long editCost, std::mt19937 &random, const char *given = nullptr) {
+	std::vector<Replacement> replacements;
+	GetReplacements(selections, [&random, given](const Selection &selection, Replacement &replacement) {
+		const char *text = given ? given : texts[random() % 5];
+		replacement = Replacement{ selection.start(), selection.end(), text, static_cast<Sci_Position>(std::strlen(text)) };
+		return true;
+	}, replacements);
+
+	notified = &editor;
+	CoalescedModifications<HeadlessEditor> coalesced(editor, coalesce, NotifyEditor);
+	coalesced.KeepOriginal(replacements.front().start, replacements.back().end);
+	const Sci_Position lengthBefore = editor.GetLength();
+
+	ReplaceText(editor, replacements, editCost);
+
+	coalesced.Add(replacements.front().start, replacements.back().end, editor.GetLength() - lengthBefore);
+}
+
+int main() {
+	std::mt19937 random(9);
+
+	for (int trial = 0; trial < 5000; ++trial) {
+		const std::string text = RandomText(random, "ab \r\n", 1 + random() % 200);
+		std::vector<Selection> selections;
+		for (size_t i = 1 + random() % 20; i > 0; --i) {
+			const Sci_Position caret = random() % (text.size() + 1);
+			const Sci_Position anchor = (random() % 2 == 0) ? caret : random() % (text.size() + 1);
+			selections.emplace_back(caret, anchor);
+		}
+		const bool coalesce = random() % 2 == 0;
+
+		HeadlessEditor editor(text);
+		editor.recordModifications = true;
+		ReplaceSelections(editor, selections, coalesce, (random() % 2 == 0) ? 0 : 1024, random);
+
+		CHECK(Replay(text, editor.modifications) == editor.Text());
+		CHECK_EQUAL(SC_MODEVENTMASKALL, editor.GetModEventMask());
+
+		// Either one insertion and one deletion, or all four for every
+		// replacement Scintilla was asked to make
+		if (coalesce)
+			CHECK(editor.notifications <= 2);
+		else
+			CHECK(editor.notifications <= 4 * editor.replacements);
+	}
+
+	// A column of carets on lines far enough apart not to get grouped
+	std::string lines;
+	for (int line = 0; line < 1000; ++line)
+		lines += "\tif (value > limit) return Clamp(value, 0, limit);\r\n";
+
+	std::vector<Selection> column;
+	for (Sci_Position line = 0; line < 1000; ++line)
+		column.emplace_back(line * 52 + 1, line * 52 + 3);
+
+	for (const bool coalesce : { false, true }) {
+		HeadlessEditor editor(lines);
+		std::vector<Selection> selections = column;
+		ReplaceSelections(editor, selections, coalesce, 1024, random, "x");
+		CHECK_EQUAL(coalesce ? 2 : 4000, editor.notifications);
+	}
+
+	// Deleted text can only be reported if it was kept
+	{
+		HeadlessEditor editor("first\r\nsecond\r\nthird");
+		editor.recordModifications = true;
+		notified = &editor;
+		{
+			CoalescedModifications<HeadlessEditor> coalesced(editor, true, NotifyEditor);
+			coalesced.KeepOriginal(7, 13);
+			editor.SetTargetRange(5, 9);
+			editor.ReplaceTarget(1, "-");
+			coalesced.Add(5, 9, -3);
+		}
+		CHECK_EQUAL(1, editor.notifications);
+		CHECK(editor.modifications.front().type & SC_MOD_INSERTTEXT);
+	}
+
+	// And only what other plugins asked for is sent
+	{
+		HeadlessEditor editor("first\r\nsecond");
+		editor.SetModEventMask(SC_MOD_INSERTTEXT);
+		notified = &editor;
+		{
+			CoalescedModifications<HeadlessEditor> coalesced(editor, true, NotifyEditor);
+			coalesced.KeepOriginal(0, 13);
+			editor.SetTargetRange(0, 5);
+			editor.ReplaceTarget(4, "last");
+			coalesced.Add(0, 5, -1);
+		}
+		CHECK_EQUAL(1, editor.notifications);
+		CHECK_EQUAL(SC_MOD_INSERTTEXT, editor.GetModEventMask());
+	}
+
+	return TestResult("CoalescedModificationsTests");
+}
@@ -0,0 +1,225 @@
+// This file is part of BetterMultiSelection.
+// 
+// Copyright (C)2017 Justin Dailey <dail8859@yahoo.com>
+// 
+// BetterMultiSelection is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "CaretMovement.h"
+#include "CostModel.h"
+#include "SelectionEdit.h"
+
+#include "Benchmark.h"
+#include "HeadlessEditor.h"
+
+// Times the plugin's side of a batch on this machine, the way the plugin runs
+// it against the editor, and prints the costs to put in BetterMultiSelection.ini.
+// moveCost and editCost depend on how long Scintilla takes per selection, which
+// can only be measured in Notepad++, so they are worked out from the nanoseconds
+// given or from rough figures for it otherwise:
+//
+//   CostCalibration [move nanoseconds] [edit nanoseconds]
+//
+// The costs are in units of reading one byte of the document, so everything is
+// divided by how long the batch takes per byte of text between the carets. The
+// defaults in CostModel.h are what this prints on a typical machine.
+
+// Roughly what Scintilla takes to move and to edit one selection when the plugin
+// sends it the messages, including selecting it and reading it back
+static const double defaultMoveNanoseconds = 1000;
+static const double defaultEditNanoseconds = 4000;
+
+// Keeps the results so the work can't be optimized away
+static volatile Sci_Position sink = 0;
+
+// Leaves the gap halfway through the document, as if the last edit was there,
+// so reading the text has to move it the way it would in Scintilla
+static void PutGapInMiddle(HeadlessEditor &editor) {
+	const Sci_Position middle = editor.GetLength() / 2;
+	editor.SetTargetRange(middle, middle);
+	editor.ReplaceTarget(1, "x");
+	editor.SetTargetRange(middle, middle + 1);
+	editor.ReplaceTarget(0, "");
+}
+
+// What MoveSelections and MoveSelectionsVertically do, together: read the lines
+// around the carets and move each of them to the next word and down a line
+static void MoveBatch(HeadlessEditor &editor, std::vector<Selection> &selections, std::vector<Sci_Position> &lineStarts) {
+	const CharacterClassifier classifier;
+	const Sci_Position length = editor.GetLength();
+	const Sci_Position start = editor.PositionFromLine(std::max(editor.LineFromPosition(selections.front().caret) - 1, static_cast<Sci_Position>(0)));
+	const Sci_Position lastLine = editor.LineFromPosition(selections.back().caret) + 2;
+	const Sci_Position end = (lastLine < editor.GetLineCount()) ? editor.PositionFromLine(lastLine) : length;
+	DocumentSnapshot doc(editor.GetRangePointer(start, end - start), start, end, length, true, &classifier);
+	doc.IndexLines(lineStarts);
+
+	for (auto &selection : selections) {
+		sink += doc.NextWordStart(selection.caret, 1);
+		const Sci_Position pos = doc.PositionUpOrDown(selection.caret, 1, doc.Column(selection.caret, 4), 4);
+		if (pos != DocumentSnapshot::invalidPosition)
+			selection.set(pos);
+	}
+	MergeSelections(selections);
+}
+
+// What DeleteSelections does for backspace: read the text around the carets,
+// work out the replacements, group and make them and put the carets after them
+static void EditBatch(HeadlessEditor &editor, std::vector<Selection> &selections, std::vector<Replacement> &replacements, int editCost) {
+	const Sci_Position length = editor.GetLength();
+	const Sci_Position start = editor.PositionFromLine(std::max(editor.LineFromPosition(selections.front().caret) - 1, static_cast<Sci_Position>(0)));
+	const Sci_Position lastLine = editor.LineFromPosition(selections.back().caret) + 2;
+	const Sci_Position end = (lastLine < editor.GetLineCount()) ? editor.PositionFromLine(lastLine) : length;
+	const DocumentSnapshot doc(editor.GetRangePointer(start, end - start), start, end, length, true);
+
+	const bool replaced = GetReplacements(selections, [&doc](const Selection &selection, Replacement &replacement) {
+		replacement = Replacement{ doc.PositionBefore(selection.caret), selection.caret, "", 0 };
+		return replacement.start != DocumentSnapshot::invalidPosition;
+	}, replacements);
+	if (!replaced)
+		return;
+
+	ReplaceText(editor, replacements, editCost);
+	SetCaretsAfterReplacements(replacements, selections);
+}
+
+static std::string CodeLines(size_t count) {
+	std::string text;
+	for (size_t line = 0; line < count; ++line)
+		text += "\tif (value_" + std::to_string(line) + " > limit) return Clamp(value, 0, limit);\r\n";
+	return text;
+}
+
+// A caret a few characters into every line but the last
+static std::vector<Selection> CaretPerLine(const std::string &text) {
+	std::vector<Selection> carets;
+	Sci_Position lineStart = 0;
+	for (size_t i = 0; i < text.size(); ++i) {
+		if (text[i] == '\n' && i + 1 < text.size()) {
+			carets.emplace_back(lineStart + 4, lineStart + 4);
+			lineStart = static_cast<Sci_Position>(i + 1);
+		}
+	}
+	return carets;
+}
+
+// The nanoseconds a batch takes to set up, per byte between the first and last
+// caret and per caret, for one kind of batch
+struct BatchTimes {
+	double setup;
+	double perByte;
+	double perCaret;
+};
+
+template<typename Run>
+static BatchTimes TimeBatches(Run run) {
+	const std::string document = CodeLines(50000);
+	const std::vector<Selection> carets = CaretPerLine(document);
+
+	HeadlessEditor editor;
+	std::vector<Selection> selections;
+	const auto setupDocument = [&](const std::vector<Selection> &input) {
+		editor.SetText(document);
+		PutGapInMiddle(editor);
+		selections = input;
+	};
+
+	// A single caret on a short document is all setup. It is too quick to time
+	// once, so there is one batch after another, each on a document of its own.
+	const int repeat = 10000;
+	const std::string lines = CodeLines(3);
+	const Selection caret = CaretPerLine(lines)[1];
+	std::vector<HeadlessEditor> editors;
+	const double setup = BestTime(5, [&]() { editors.assign(repeat, HeadlessEditor(lines)); }, [&]() {
+		for (auto &small : editors) {
+			selections.assign(1, caret);
+			run(small, selections);
+		}
+	}) * 1e6 / repeat;
+
+	// Two carets far apart are almost all reading the text between them
+	const std::vector<Selection> apart{ carets[1], carets[carets.size() - 2] };
+	const double span = static_cast<double>(apart.back().caret - apart.front().caret);
+	const double perByte = (BestTime(5, [&]() { setupDocument(apart); }, [&]() { run(editor, selections); }) * 1e6 - setup) / span;
+
+	// And what is left over with a caret on every line is the carets themselves
+	const double all = BestTime(5, [&]() { setupDocument(carets); }, [&]() { run(editor, selections); }) * 1e6;
+	const double perCaret = (all - setup - perByte * (carets.back().caret - carets.front().caret)) / carets.size();
+
+	return BatchTimes{ setup, perByte, perCaret };
+}
+
+static int ToCost(double nanoseconds, double perByte) {
+	return static_cast<int>(std::max(nanoseconds / perByte, 0.0) + 0.5);
+}
+
+int main(int argc, char *argv[]) {
+	const Costs defaults;
+
+	std::vector<Sci_Position> lineStarts;
+	const BatchTimes move = TimeBatches([&lineStarts](HeadlessEditor &editor, std::vector<Selection> &selections) {
+		MoveBatch(editor, selections, lineStarts);
+	});
+
+	std::vector<Replacement> replacements;
+	const BatchTimes edit = TimeBatches([&replacements, &defaults](HeadlessEditor &editor, std::vector<Selection> &selections) {
+		EditBatch(editor, selections, replacements, defaults.edit);
+	});
+
+	std::printf("Moving a batch takes %.0f ns to set up, %.2f ns per byte and %.1f ns per caret\n", move.setup, move.perByte, move.perCaret);
+	std::printf("Editing a batch takes %.0f ns to set up, %.2f ns per byte and %.1f ns per caret\n", edit.setup, edit.perByte, edit.perCaret);
+
+	// Reading the text between the carets is what both have in common, so
+	// moving is the measure of it. Edits are the more expensive of the two, and
+	// since they are what lots of carets cost the most with, the batch is
+	// costed as one.
+	const double perByte = move.perByte;
+	const double moveNanoseconds = (argc == 3) ? std::atof(argv[1]) : defaultMoveNanoseconds;
+	const double editNanoseconds = (argc == 3) ? std::atof(argv[2]) : defaultEditNanoseconds;
+	if (argc != 3)
+		std::printf("For moveCost and editCost pass the nanoseconds Scintilla takes per selection to move and to edit, %.0f and %.0f are assumed\n", defaultMoveNanoseconds, defaultEditNanoseconds);
+
+	Costs costs;
+	costs.move = ToCost(moveNanoseconds, perByte);
+	costs.edit = ToCost(editNanoseconds, perByte);
+	costs.batch = ToCost(std::max(move.setup, edit.setup), perByte);
+	costs.caret = ToCost(std::max(move.perCaret, edit.perCaret), perByte);
+
+	std::printf("moveCost=%d\n", costs.move);
+	std::printf("editCost=%d\n", costs.edit);
+	std::printf("batchCost=%d\n", costs.batch);
+	std::printf("caretCost=%d\n", costs.caret);
+
+	// What the costs decide for two carets, the fewest the plugin handles
+	for (const bool modifiesDocument : { false, true }) {
+		Sci_Position batched = -1;
+		Sci_Position notBatched = 1LL << 40;
+		while (notBatched - batched > 1) {
+			const Sci_Position apart = batched + (notBatched - batched) / 2;
+			if (ChooseStrategy(costs, { Selection(0, 0), Selection(apart, apart) }, modifiesDocument, 1) == Strategy::Batch)
+				batched = apart;
+			else
+				notBatched = apart;
+		}
+		std::printf("Two carets are %s in a batch up to %lld bytes apart\n", modifiesDocument ? "edited" : "moved", static_cast<long long>(batched));
+	}
+
+	return 0;
+}
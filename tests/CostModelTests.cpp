@@ -0,0 +1,73 @@
+// This file is part of BetterMultiSelection.
+// 
+// Copyright (C)2017 Justin Dailey <dail8859@yahoo.com>
+// 
+// BetterMultiSelection is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+
+
+#include <utility>
+#include <vector>
+
+#include "CostModel.h"
+
+#include "Testing.h"
+
+static std::vector<Selection> Column(size_t count, Sci_Position lineLength) {
+	std::vector<Selection> selections;
+	for (size_t line = 0; line < count; ++line)
+		selections.emplace_back(line * lineLength, line * lineLength);
+	return selections;
+}
+
+int main() {
+	Costs costs;
+	costs.move = 1000;
+	costs.edit = 4000;
+	costs.batch = 1000;
+	costs.caret = 100;
+
+	// Two carets close together are worth a batch, far apart they aren't
+	CHECK(ChooseStrategy(costs, Column(2, 10), false, 1) == Strategy::Batch);
+	CHECK(ChooseStrategy(costs, Column(2, 1000), false, 1) == Strategy::EachSelection);
+	// 2 * 1000 against 1000 + 799 + 2 * 100, and one byte further
+	CHECK(ChooseStrategy(costs, Column(2, 799), false, 1) == Strategy::Batch);
+	CHECK(ChooseStrategy(costs, Column(2, 800), false, 1) == Strategy::EachSelection);
+
+	// Edits cost Scintilla more so they are batched further apart
+	CHECK(ChooseStrategy(costs, Column(2, 1000), true, 1) == Strategy::Batch);
+
+	// Every step is another run of the command for each selection, and another
+	// move for the batch to work out
+	CHECK(ChooseStrategy(costs, Column(2, 1500), false, 1) == Strategy::EachSelection);
+	CHECK(ChooseStrategy(costs, Column(2, 1500), false, 2) == Strategy::Batch);
+	CHECK(ChooseStrategy(costs, Column(2, 800), false, 0) == Strategy::EachSelection);
+
+	// A batch that costs as much per caret as Scintilla never pays off
+	costs.caret = costs.move;
+	CHECK(ChooseStrategy(costs, Column(100000, 1), false, 1) == Strategy::EachSelection);
+
+	// Otherwise lots of carets spread the setup between them, so they are
+	// batched further apart than two would be
+	costs.caret = 100;
+	CHECK(ChooseStrategy(costs, Column(100000, 800), false, 1) == Strategy::Batch);
+
+	// The order of the selections doesn't matter
+	std::vector<Selection> reversed = Column(2, 799);
+	std::swap(reversed[0], reversed[1]);
+	CHECK(ChooseStrategy(costs, reversed, false, 1) == Strategy::Batch);
+
+	return TestResult("CostModelTests");
+}
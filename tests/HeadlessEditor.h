@@ -0,0 +1,439 @@
+// This file is part of BetterMultiSelection.
+// 
+// Copyright (C)2017 Justin Dailey <dail8859@yahoo.com>
+// 
+// BetterMultiSelection is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+#pragma once
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Scintilla.h"
+#include "SelectionSet.h"
+
+// Stands in for Scintilla so the parts of the plugin written against an editor
+// can run without Windows. It has the same methods as PositionEditor, keeps the
+// text in a gap buffer the way Scintilla does and counts the calls that cost
+// something in the real thing. Indicators and markers can be placed to check
+// that they are respected, but edits don't move them.
+class HeadlessEditor final {
+private:
+	std::vector<char> body;
+	Sci_Position part1Length = 0;
+	Sci_Position gapLength = 0;
+
+	// Rebuilt on demand after the text changes
+	mutable std::vector<Sci_Position> lineStarts;
+	mutable bool linesValid = false;
+
+	Sci_Position targetStart = 0;
+	Sci_Position targetEnd = 0;
+	// Scintilla's Selection: the ranges, which is the main one, the type and
+	// the rectangle the ranges were made from
+	std::vector<Selection> selections{ Selection(0, 0) };
+	int mainSelection = 0;
+	int selectionMode = SC_SEL_STREAM;
+	bool moveExtends = false;
+	Selection rectangle{ 0, 0 };
+
+	int modEventMask = SC_MODEVENTMASKALL;
+	bool readOnly = false;
+	bool allLinesVisible = true;
+	int undoDepth = 0;
+	std::vector<std::pair<Sci_Position, Sci_Position>> indicatorRuns;
+	std::vector<Sci_Position> markerLines;
+
+	void GapTo(Sci_Position position) {
+		if (position < part1Length)
+			std::memmove(&body[position + gapLength], &body[position], part1Length - position);
+		else if (position > part1Length)
+			std::memmove(&body[part1Length], &body[part1Length + gapLength], position - part1Length);
+		gapMoved += std::abs(position - part1Length);
+		part1Length = position;
+	}
+
+	void RoomFor(Sci_Position insertionLength) {
+		if (gapLength >= insertionLength)
+			return;
+
+		const Sci_Position position = part1Length;
+		GapTo(GetLength());
+		const Sci_Position growth = insertionLength + static_cast<Sci_Position>(body.size()) / 2 + 64;
+		body.resize(body.size() + growth);
+		gapLength += growth;
+		GapTo(position);
+	}
+
+	void IndexLines() const {
+		if (linesValid)
+			return;
+
+		lineStarts.assign(1, 0);
+		const Sci_Position length = GetLength();
+		for (Sci_Position position = 0; position < length; ++position) {
+			const char ch = CharAt(position);
+			if (ch == '\n' || (ch == '\r' && (position + 1 == length || CharAt(position + 1) != '\n')))
+				lineStarts.push_back(position + 1);
+		}
+		linesValid = true;
+	}
+
+	static Sci_Position CountLines(const char *text, Sci_Position length) {
+		Sci_Position lines = 0;
+		for (Sci_Position i = 0; i < length; ++i) {
+			if (text[i] == '\n' || (text[i] == '\r' && (i + 1 == length || text[i + 1] != '\n')))
+				++lines;
+		}
+		return lines;
+	}
+
+	void NotifyModified(int type, Sci_Position position, Sci_Position length, const char *text) {
+		if ((type & modEventMask) == 0)
+			return;
+
+		SCNotification scn = {};
+		scn.nmhdr.code = SCN_MODIFIED;
+		scn.modificationType = type | SC_PERFORMED_USER;
+		scn.position = position;
+		scn.length = length;
+		scn.text = text;
+		if (type & (SC_MOD_INSERTTEXT | SC_MOD_DELETETEXT))
+			scn.linesAdded = (type & SC_MOD_DELETETEXT) ? -CountLines(text, length) : CountLines(text, length);
+		Notify(scn);
+	}
+
+public:
+	// A notification as the parent window gets it, with a copy of the text
+	struct Modification {
+		int type;
+		Sci_Position position;
+		Sci_Position length;
+		Sci_Position linesAdded;
+		bool hasText;
+		std::string text;
+	};
+
+	// What the real thing would have spent time on
+	long long replacements = 0;
+	long long gapMoved = 0;
+	long long notifications = 0;
+	long long trims = 0;
+	long long linesLaidOut = 0;
+	int undoActions = 0;
+
+	// Only kept when asked for, since every one is copied
+	bool recordModifications = false;
+	std::vector<Modification> modifications;
+
+	explicit HeadlessEditor(const std::string &text = std::string()) {
+		SetText(text);
+	}
+
+	void SetText(const std::string &text) {
+		body.assign(text.cbegin(), text.cend());
+		part1Length = static_cast<Sci_Position>(body.size());
+		gapLength = 0;
+		linesValid = false;
+		ClearSelections();
+	}
+
+	std::string Text() const {
+		std::string text(body.cbegin(), body.cbegin() + part1Length);
+		text.append(body.cbegin() + part1Length + gapLength, body.cend());
+		return text;
+	}
+
+	char CharAt(Sci_Position position) const {
+		return (position < part1Length) ? body[position] : body[position + gapLength];
+	}
+
+	int GetModEventMask() const { return modEventMask; }
+	void SetModEventMask(int mask) { modEventMask = mask; }
+
+	// Where SCN_MODIFIED goes, both from the editor itself and from the plugin
+	void Notify(const SCNotification &scn) {
+		++notifications;
+		if (recordModifications) {
+			const bool hasText = scn.text != nullptr;
+			modifications.push_back(Modification{ scn.modificationType, scn.position, scn.length, scn.linesAdded, hasText, hasText ? std::string(scn.text, scn.length) : std::string() });
+		}
+	}
+
+	void SetReadOnly(bool value) { readOnly = value; }
+	bool GetReadOnly() const { return readOnly; }
+
+	void SetAllLinesVisible(bool value) { allLinesVisible = value; }
+	bool GetAllLinesVisible() const { return allLinesVisible; }
+
+	Sci_Position GetLength() const { return static_cast<Sci_Position>(body.size()) - gapLength; }
+	Sci_Position GetGapPosition() const { return part1Length; }
+
+	// Like Scintilla, a range that straddles the gap moves the gap to its start
+	const char *GetRangePointer(Sci_Position start, Sci_Position length) {
+		if (start < part1Length && start + length > part1Length)
+			GapTo(start);
+		return (start < part1Length) ? &body[start] : &body[start + gapLength];
+	}
+
+	Sci_Position GetLineCount() const {
+		IndexLines();
+		return static_cast<Sci_Position>(lineStarts.size());
+	}
+
+	Sci_Position LineFromPosition(Sci_Position position) const {
+		IndexLines();
+		return static_cast<Sci_Position>(std::upper_bound(lineStarts.cbegin(), lineStarts.cend(), position) - lineStarts.cbegin()) - 1;
+	}
+
+	Sci_Position PositionFromLine(Sci_Position line) const {
+		IndexLines();
+		if (line < 0 || line >= static_cast<Sci_Position>(lineStarts.size()))
+			return -1;
+		return lineStarts[line];
+	}
+
+	Sci_Position GetLineEndPosition(Sci_Position line) const {
+		IndexLines();
+		Sci_Position end = (line + 1 < static_cast<Sci_Position>(lineStarts.size())) ? lineStarts[line + 1] : GetLength();
+		if (end > lineStarts[line] && line + 1 < static_cast<Sci_Position>(lineStarts.size())) {
+			--end;
+			if (end > lineStarts[line] && CharAt(end) == '\n' && CharAt(end - 1) == '\r')
+				--end;
+		}
+		return end;
+	}
+
+	void BeginUndoAction() {
+		if (undoDepth++ == 0)
+			++undoActions;
+	}
+
+	void EndUndoAction() {
+		--undoDepth;
+	}
+
+	void SetTargetRange(Sci_Position start, Sci_Position end) {
+		targetStart = start;
+		targetEnd = end;
+	}
+
+	Sci_Position GetTargetStart() const { return targetStart; }
+	Sci_Position GetTargetEnd() const { return targetEnd; }
+
+	Sci_Position ReplaceTarget(Sci_Position length, const char *text) {
+		if (readOnly)
+			return 0;
+
+		++replacements;
+
+		const Sci_Position deleted = targetEnd - targetStart;
+		if (deleted > 0) {
+			NotifyModified(SC_MOD_BEFOREDELETE, targetStart, deleted, nullptr);
+			GapTo(targetStart);
+			gapLength += deleted;
+			MoveForInsertDelete(false, targetStart, deleted);
+			// The deleted text is still there at the end of the gap
+			NotifyModified(SC_MOD_DELETETEXT, targetStart, deleted, &body[part1Length + gapLength - deleted]);
+		}
+
+		if (length > 0) {
+			NotifyModified(SC_MOD_BEFOREINSERT, targetStart, length, text);
+			GapTo(targetStart);
+			RoomFor(length);
+			std::memcpy(&body[part1Length], text, length);
+			part1Length += length;
+			gapLength -= length;
+			MoveForInsertDelete(true, targetStart, length);
+			NotifyModified(SC_MOD_INSERTTEXT, targetStart, length, text);
+		}
+
+		linesValid = false;
+		targetEnd = targetStart + length;
+		return length;
+	}
+
+	// Scintilla's SelectionPosition::MoveForInsertDelete() for every selection
+	// and the rectangle
+	void MoveForInsertDelete(bool insertion, Sci_Position startChange, Sci_Position length) {
+		const auto move = [=](Sci_Position position) {
+			if (insertion)
+				return (position > startChange) ? position + length : position;
+			if (position > startChange)
+				return (position > startChange + length) ? position - length : startChange;
+			return position;
+		};
+
+		for (auto &selection : selections) {
+			selection.caret = move(selection.caret);
+			selection.anchor = move(selection.anchor);
+		}
+		rectangle.caret = move(rectangle.caret);
+		rectangle.anchor = move(rectangle.anchor);
+	}
+
+	void ClearSelections() {
+		selections.assign(1, Selection(0, 0));
+		mainSelection = 0;
+		selectionMode = SC_SEL_STREAM;
+		moveExtends = false;
+		rectangle = Selection(0, 0);
+	}
+
+	int GetSelections() const { return static_cast<int>(selections.size()); }
+	Sci_Position GetSelectionNCaret(int selection) const { return selections[selection].caret; }
+	Sci_Position GetSelectionNAnchor(int selection) const { return selections[selection].anchor; }
+	void SetSelectionNCaret(int selection, Sci_Position caret) { selections[selection].caret = caret; }
+	void SetSelectionNAnchor(int selection, Sci_Position anchor) { selections[selection].anchor = anchor; }
+	int GetMainSelection() const { return mainSelection; }
+	void SetMainSelection(int selection) { mainSelection = selection; }
+
+	void SetSelection(Sci_Position caret, Sci_Position anchor) {
+		selections.assign(1, Selection(caret, anchor));
+		mainSelection = 0;
+	}
+
+	// Scintilla's Selection::AddSelection() trims every selection but the main
+	// one against the new one, removing any that end up empty
+	void AddSelection(Sci_Position caret, Sci_Position anchor) {
+		const Selection range(caret, anchor);
+		for (size_t i = 0; i < selections.size();) {
+			++trims;
+			if (static_cast<int>(i) != mainSelection && Trim(selections[i], range)) {
+				selections.erase(selections.begin() + i);
+				if (static_cast<int>(i) < mainSelection)
+					--mainSelection;
+			}
+			else {
+				++i;
+			}
+		}
+		selections.push_back(range);
+		mainSelection = static_cast<int>(selections.size()) - 1;
+	}
+
+	// Scintilla's SelectionRange::Trim(). Returns whether it is left empty.
+	static bool Trim(Selection &selection, const Selection &range) {
+		Sci_Position start = selection.start();
+		Sci_Position end = selection.end();
+		if (range.start() > end || range.end() < start)
+			return false;
+
+		if ((start > range.start() && end < range.end()) || (start < range.start() && end > range.end()))
+			end = start;
+		else if (start <= range.start())
+			end = range.start();
+		else
+			start = range.end();
+
+		if (selection.anchor > selection.caret)
+			selection = Selection(start, end);
+		else
+			selection = Selection(end, start);
+		return start == end;
+	}
+
+	int GetSelectionMode() const { return selectionMode; }
+	bool GetMoveExtendsSelection() const { return moveExtends; }
+
+	// Picking a mode again toggles whether moves extend. Switching to a
+	// rectangle makes the main selection the rectangle.
+	void SetSelectionMode(int mode) {
+		moveExtends = !moveExtends || selectionMode != mode;
+		selectionMode = mode;
+		if (mode == SC_SEL_RECTANGLE)
+			rectangle = selections[mainSelection];
+	}
+
+	void SetRectangularSelectionAnchor(Sci_Position anchor) {
+		if (selectionMode != SC_SEL_RECTANGLE)
+			ClearSelections();
+		selectionMode = SC_SEL_RECTANGLE;
+		rectangle.anchor = anchor;
+		SetRectangularRange();
+	}
+
+	void SetRectangularSelectionCaret(Sci_Position caret) {
+		if (selectionMode != SC_SEL_RECTANGLE)
+			ClearSelections();
+		selectionMode = SC_SEL_RECTANGLE;
+		rectangle.caret = caret;
+		SetRectangularRange();
+	}
+
+	// Scintilla's Editor::SetRectangularRange(), with every character as
+	// wide as the others. Each line has to be laid out to find its positions.
+	void SetRectangularRange() {
+		const Sci_Position anchorLine = LineFromPosition(rectangle.anchor);
+		const Sci_Position caretLine = LineFromPosition(rectangle.caret);
+		const Sci_Position anchorColumn = rectangle.anchor - PositionFromLine(anchorLine);
+		const Sci_Position caretColumn = rectangle.caret - PositionFromLine(caretLine);
+		const Sci_Position increment = (caretLine > anchorLine) ? 1 : -1;
+
+		selections.clear();
+		for (Sci_Position line = anchorLine; line != caretLine + increment; line += increment) {
+			++linesLaidOut;
+			const Sci_Position lineStart = PositionFromLine(line);
+			const Sci_Position lineEnd = GetLineEndPosition(line);
+			selections.emplace_back(std::min(lineStart + caretColumn, lineEnd), std::min(lineStart + anchorColumn, lineEnd));
+		}
+		mainSelection = static_cast<int>(selections.size()) - 1;
+	}
+
+	void SetIndicatorRun(Sci_Position start, Sci_Position end) {
+		indicatorRuns.emplace_back(start, end);
+		std::sort(indicatorRuns.begin(), indicatorRuns.end());
+	}
+
+	void AddMarker(Sci_Position line) {
+		markerLines.push_back(line);
+		std::sort(markerLines.begin(), markerLines.end());
+	}
+
+	// Only indicator 0 is ever set
+	int IndicatorValueAt(int indicator, Sci_Position position) const {
+		if (indicator != 0)
+			return 0;
+		for (const auto &run : indicatorRuns) {
+			if (position >= run.first && position < run.second)
+				return 1;
+		}
+		return 0;
+	}
+
+	Sci_Position IndicatorEnd(int indicator, Sci_Position position) const {
+		if (indicator != 0 || indicatorRuns.empty())
+			return 0;
+		for (const auto &run : indicatorRuns) {
+			if (run.first > position)
+				return run.first;
+			if (run.second > position)
+				return run.second;
+		}
+		return GetLength();
+	}
+
+	Sci_Position MarkerNext(Sci_Position lineStart, int) const {
+		const auto marker = std::lower_bound(markerLines.cbegin(), markerLines.cend(), lineStart);
+		return (marker != markerLines.cend()) ? *marker : -1;
+	}
+
+	int AnnotationGetLines(Sci_Position) const { return 0; }
+	int MarginGetText(Sci_Position, char *) const { return 0; }
+};
@@ -0,0 +1,225 @@
+// This file is part of BetterMultiSelection.
+// 
+// Copyright (C)2017 Justin Dailey <dail8859@yahoo.com>
+// 
+// BetterMultiSelection is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+#include <algorithm>
+#include <cstdio>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "CaretMovement.h"
+#include "SelectionEdit.h"
+
+#include "Benchmark.h"
+#include "HeadlessEditor.h"
+
+// Backspace with a caret on every line, done by the batch engine and caret by
+// caret the way the plugin falls back to. The editor only stands in for
+// Scintilla, so what carries over is how many replacements Scintilla would be
+// asked for, how far its gap has to move and how many notifications other
+// plugins get, more than the times themselves.
+
+static std::string Lines(size_t count) {
+	std::string text;
+	for (size_t line = 0; line < count; ++line)
+		text += "\tvalue = limit;\r\n";
+	return text;
+}
+
+static std::vector<Selection> CaretPerLine(size_t count) {
+	std::vector<Selection> selections;
+	for (size_t line = 0; line < count; ++line) {
+		const Sci_Position caret = static_cast<Sci_Position>(line * 17 + 7);
+		selections.emplace_back(caret, caret);
+	}
+	return selections;
+}
+
+static bool DeleteBackInBatch(HeadlessEditor &editor, std::vector<Selection> &selections, std::vector<Replacement> &replacements) {
+	const Sci_Position length = editor.GetLength();
+	const DocumentSnapshot doc(editor.GetRangePointer(0, length), 0, length, length, true);
+
+	const bool replaced = GetReplacements(selections, [&doc](const Selection &selection, Replacement &replacement) {
+		replacement = Replacement{ doc.PositionBefore(selection.caret), selection.caret, "", 0 };
+		return replacement.start != DocumentSnapshot::invalidPosition;
+	}, replacements);
+	if (!replaced)
+		return false;
+
+	ReplaceText(editor, replacements, 1024);
+	SetCaretsAfterReplacements(replacements, selections);
+	return true;
+}
+
+// What Scintilla does for each caret when it runs the command
+static void DeleteBackEachCaret(HeadlessEditor &editor, std::vector<Selection> &selections) {
+	editor.BeginUndoAction();
+
+	Sci_Position totalOffset = 0;
+	for (auto &selection : selections) {
+		selection.offset(totalOffset);
+		const Sci_Position caret = selection.caret;
+		// Enough to step back over any character
+		const Sci_Position length = editor.GetLength();
+		const Sci_Position start = (caret > 8) ? caret - 8 : 0;
+		const Sci_Position end = (caret + 8 < length) ? caret + 8 : length;
+		const DocumentSnapshot doc(editor.GetRangePointer(start, end - start), start, end, length, true);
+		const Sci_Position before = doc.PositionBefore(caret);
+
+		editor.SetTargetRange(before, caret);
+		editor.ReplaceTarget(0, "");
+		selection.set(before);
+		totalOffset -= caret - before;
+	}
+
+	editor.EndUndoAction();
+}
+
+// How the plugin used to tidy up the selections before MergeSelections: sort
+// iterators to them, drop the exact duplicates, sort the rest back into their
+// original order and swap them to the front. Overlapping selections were left
+// for Scintilla to trim.
+template<typename It>
+It uniquify(It begin, It const end)
+{
+	std::vector<It> v;
+	v.reserve(static_cast<size_t>(std::distance(begin, end)));
+
+	for (It i = begin; i != end; ++i)
+		v.push_back(i);
+
+	std::sort(v.begin(), v.end(), [](const auto &lhs, const auto &rhs) {
+		return (*lhs).start() < (*rhs).start() || (!((*rhs).start() < (*lhs).start()) && (*lhs).end() < (*rhs).end());
+	});
+
+	v.erase(std::unique(v.begin(), v.end(), [](const auto &lhs, const auto &rhs) {
+		return (*lhs).start() == (*rhs).start() && (*lhs).end() == (*rhs).end();
+	}), v.end());
+
+	std::sort(v.begin(), v.end());
+
+	size_t j = 0;
+	for (It i = begin; i != end && j != v.size(); ++i) {
+		if (i == v[j]) {
+			using std::iter_swap; iter_swap(i, begin);
+			++j;
+			++begin;
+		}
+	}
+	return begin;
+}
+
+int main(int argc, char *argv[]) {
+	const bool quick = IsQuickRun(argc, argv);
+
+	std::printf("Backspace with a caret on every line\n");
+	for (const size_t count : { 1000, 10000, 100000 }) {
+		if (quick && count > 1000)
+			break;
+
+		const std::string text = Lines(count);
+		const std::vector<Selection> carets = CaretPerLine(count);
+
+		HeadlessEditor editor;
+		std::vector<Selection> selections;
+		std::vector<Replacement> replacements;
+
+		const auto setup = [&]() {
+			editor = HeadlessEditor(text);
+			selections = carets;
+		};
+
+		bool replaced = false;
+		const double batch = BestTime(5, setup, [&]() { replaced = DeleteBackInBatch(editor, selections, replacements); });
+		const long long batchReplacements = editor.replacements;
+		const long long batchGapMoved = editor.gapMoved;
+		const long long batchNotifications = editor.notifications;
+		const std::string batchText = editor.Text();
+
+		const double eachCaret = BestTime(5, setup, [&]() { DeleteBackEachCaret(editor, selections); });
+		if (!replaced || editor.Text() != batchText) {
+			std::printf("The batch and going caret by caret don't agree\n");
+			return 1;
+		}
+
+		std::printf("%7zu carets: batch          %8.2f ms, %6lld replacements, %6lld notifications, gap moved %8lld bytes\n", count, batch, batchReplacements, batchNotifications, batchGapMoved);
+		std::printf("%7s         caret by caret %8.2f ms, %6lld replacements, %6lld notifications, gap moved %8lld bytes\n", "", eachCaret, editor.replacements, editor.notifications, editor.gapMoved);
+	}
+
+	// Restoring the selections afterwards, one at a time with AddSelection or
+	// with a rectangle as a scaffold. Adding them one at a time grows
+	// quadratically so it isn't tried with the most.
+	std::printf("Restoring a selection on every line\n");
+	for (const size_t count : { 1000, 10000, 100000 }) {
+		if (quick && count > 1000)
+			break;
+
+		const std::string text = Lines(count);
+		std::vector<Selection> selections = CaretPerLine(count);
+		for (auto &selection : selections)
+			selection.caret += 3;
+
+		HeadlessEditor editor;
+		const auto setup = [&]() { editor = HeadlessEditor(text); };
+
+		if (count <= 10000) {
+			const double adding = BestTime(3, setup, [&]() {
+				for (size_t i = 0; i < selections.size(); ++i)
+					editor.AddSelection(selections[i].caret, selections[i].anchor);
+			});
+			std::printf("%7zu selections: AddSelection %8.2f ms, %11lld trims\n", count, adding, editor.trims);
+		}
+
+		const double scaffold = BestTime(3, setup, [&]() { SetSelectionsWithScaffold(editor, selections); });
+		std::printf("%7zu selections: scaffold     %8.2f ms, %11lld trims, %6lld lines laid out\n", count, scaffold, editor.trims, editor.linesLaidOut);
+	}
+
+	// Merging the selections before an edit, when they are already in order
+	// the way a column of carets is, and when they come in any order with some
+	// of them twice the way they do after carets run into each other
+	std::printf("Merging the selections\n");
+	for (const size_t count : { 10000, 100000, 1000000, 10000000 }) {
+		if (quick && count > 10000)
+			break;
+
+		std::mt19937 random(13);
+		const std::vector<Selection> column = CaretPerLine(count);
+		std::vector<Selection> shuffled = column;
+		for (size_t i = 0; i < count / 10; ++i)
+			shuffled[i] = shuffled[count / 2 + i];
+		std::shuffle(shuffled.begin(), shuffled.end(), random);
+
+		std::vector<Selection> selections;
+		const auto compare = [&](const std::vector<Selection> &input, const char *order) {
+			const auto setup = [&]() { selections = input; };
+			const double merged = BestTime(3, setup, [&]() { MergeSelections(selections); });
+			const size_t mergedCount = selections.size();
+			const double uniquified = BestTime(3, setup, [&]() { selections.erase(uniquify(selections.begin(), selections.end()), selections.end()); });
+			std::printf("%8zu selections, %s: MergeSelections %8.2f ms, uniquify %8.2f ms\n", count, order, merged, uniquified);
+			return mergedCount == selections.size();
+		};
+
+		if (!compare(column, "in order ") || !compare(shuffled, "any order")) {
+			std::printf("Merging and uniquify don't agree\n");
+			return 1;
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,415 @@
+// This file is part of BetterMultiSelection.
+// 
+// Copyright (C)2017 Justin Dailey <dail8859@yahoo.com>
+// 
+// BetterMultiSelection is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "CaretMovement.h"
+#include "SelectionEdit.h"
+
+#include "HeadlessEditor.h"
+#include "Testing.h"
+
+// The batch has to end up with the same text and carets as running the command
+// for one selection after another, which is what the plugin falls back to.
+
+enum Command {
+	Paste,
+	DeleteBack,
+	DeleteForward,
+	DeleteWordLeft,
+	DeleteWordRight
+};
+
+static const std::string pasted = "pasted\r\n";
+
+// What the command replaces for the selection, the same as DeleteSelections,
+// DeleteWords and Paste work it out
+static bool CommandReplacement(const DocumentSnapshot &doc, Command command, const Selection &selection, Replacement &replacement) {
+	if (command == Paste) {
+		replacement = Replacement{ selection.start(), selection.end(), pasted.data(), static_cast<Sci_Position>(pasted.size()) };
+		return true;
+	}
+
+	if (selection.length() > 0 && (command == DeleteBack || command == DeleteForward)) {
+		replacement = Replacement{ selection.start(), selection.end(), "", 0 };
+		return true;
+	}
+
+	Sci_Position pos = DocumentSnapshot::invalidPosition;
+	switch (command) {
+		case DeleteBack: pos = (selection.caret > 0) ? doc.PositionBefore(selection.caret) : 0; break;
+		case DeleteForward: pos = doc.PositionAfter(selection.caret); break;
+		case DeleteWordLeft: pos = doc.NextWordStart(selection.caret, -1); break;
+		case DeleteWordRight: pos = doc.NextWordStart(selection.caret, 1); break;
+		default: break;
+	}
+	if (pos == DocumentSnapshot::invalidPosition)
+		return false;
+
+	replacement = Replacement{ std::min(pos, selection.caret), std::max(pos, selection.caret), "", 0 };
+	return true;
+}
+
+// Moves a position for a change the way Scintilla would. Text inserted exactly
+// at the position goes after it, unless the position belongs to a selection
+// further on that the change has to stay in front of.
+static Sci_Position MoveForChange(Sci_Position position, const Replacement &change, bool moveAtStart) {
+	if (position > change.start)
+		position = (position > change.end) ? position - (change.end - change.start) : change.start;
+	if (position > change.start || (moveAtStart && position == change.start))
+		position += change.length;
+	return position;
+}
+
+// The reference: each selection's change is made on its own, worked out from the
+// text as it is by then, and every other selection moves along with the text
+static std::string EachSelection(const std::string &original, std::vector<Selection> &selections, Command command) {
+	MergeSelections(selections);
+
+	std::string text = original;
+	const CharacterClassifier classifier;
+
+	for (size_t i = 0; i < selections.size(); ++i) {
+		const Sci_Position length = static_cast<Sci_Position>(text.size());
+		const DocumentSnapshot doc(text.data(), 0, length, length, true, &classifier);
+		Replacement change;
+		CHECK(CommandReplacement(doc, command, selections[i], change));
+
+		text.replace(change.start, change.end - change.start, change.text, change.length);
+		selections[i].set(change.start + change.length);
+
+		for (size_t j = 0; j < selections.size(); ++j) {
+			if (j != i) {
+				selections[j].caret = MoveForChange(selections[j].caret, change, j > i);
+				selections[j].anchor = MoveForChange(selections[j].anchor, change, j > i);
+			}
+		}
+	}
+
+	MergeSelections(selections);
+	return text;
+}
+
+// The same steps as ReplaceSelections in the plugin. Returns false when the
+// plugin would leave it to Scintilla instead.
+static bool Batch(HeadlessEditor &editor, std::vector<Selection> &selections, Command command, long long editCost) {
+	const std::string original = editor.Text();
+	const Sci_Position length = static_cast<Sci_Position>(original.size());
+	const CharacterClassifier classifier;
+	const DocumentSnapshot doc(original.data(), 0, length, length, true, &classifier);
+
+	std::vector<Replacement> replacements;
+	const bool replaced = GetReplacements(selections, [&doc, command](const Selection &selection, Replacement &replacement) {
+		return CommandReplacement(doc, command, selection, replacement);
+	}, replacements);
+	if (!replaced)
+		return false;
+
+	ReplaceText(editor, replacements, editCost);
+	SetCaretsAfterReplacements(replacements, selections);
+	return true;
+}
+
+static void CheckSame(const std::vector<Selection> &expected, const std::vector<Selection> &actual) {
+	CHECK_EQUAL(expected.size(), actual.size());
+	if (expected.size() != actual.size())
+		return;
+
+	for (size_t i = 0; i < expected.size(); ++i) {
+		CHECK_EQUAL(expected[i].caret, actual[i].caret);
+		CHECK_EQUAL(expected[i].anchor, actual[i].anchor);
+	}
+}
+
+// Scintilla never leaves a caret between the two characters of a line end
+static Sci_Position CharacterStart(const std::string &text, Sci_Position position) {
+	if (position > 0 && position < static_cast<Sci_Position>(text.size()) && text[position - 1] == '\r' && text[position] == '\n')
+		return position - 1;
+	return position;
+}
+
+static std::vector<Selection> RandomSelections(std::mt19937 &random, const std::string &text, size_t count, bool empty) {
+	std::uniform_int_distribution<Sci_Position> position(0, text.size());
+	std::vector<Selection> selections;
+	for (size_t i = 0; i < count; ++i) {
+		const Sci_Position caret = CharacterStart(text, position(random));
+		const Sci_Position anchor = (empty || random() % 2 == 0) ? caret : CharacterStart(text, position(random));
+		selections.emplace_back(caret, anchor);
+	}
+	return selections;
+}
+
+static std::vector<Selection> Selections(const HeadlessEditor &editor) {
+	std::vector<Selection> selections;
+	for (int i = 0; i < editor.GetSelections(); ++i)
+		selections.emplace_back(editor.GetSelectionNCaret(i), editor.GetSelectionNAnchor(i));
+	return selections;
+}
+
+// Restoring has to leave exactly the selections given, the last one main and
+// the selections no longer rectangular, whichever way it is done
+static void CheckRestored(const std::vector<Selection> &selections, const HeadlessEditor &editor, bool moveExtends) {
+	CheckSame(selections, Selections(editor));
+	CHECK_EQUAL(selections.size() - 1, editor.GetMainSelection());
+	CHECK_EQUAL(SC_SEL_STREAM, editor.GetSelectionMode());
+	CHECK_EQUAL(moveExtends, editor.GetMoveExtendsSelection());
+}
+
+// What MergeSelections is meant to do, the slow and obvious way: unite any two
+// selections that overlap until none do, each facing the way the one that
+// started it all did (the first by start, then by end), then drop the carets
+// inside or touching what is left along with any duplicates
+static std::vector<Selection> ReferenceMerge(const std::vector<Selection> &original) {
+	const auto before = [](const Selection &lhs, const Selection &rhs) {
+		return lhs.start() < rhs.start() || (lhs.start() == rhs.start() && lhs.end() < rhs.end());
+	};
+
+	// Each one along with the first of the selections it was made from
+	std::vector<std::pair<Selection, Selection>> selections;
+	for (const auto &selection : original)
+		selections.emplace_back(selection, selection);
+
+	for (bool merged = true; merged;) {
+		merged = false;
+		for (size_t i = 0; i < selections.size() && !merged; ++i) {
+			for (size_t j = i + 1; j < selections.size() && !merged; ++j) {
+				const Selection &a = selections[i].first;
+				const Selection &b = selections[j].first;
+				const bool same = a.start() == b.start() && a.end() == b.end();
+				const bool overlap = a.length() > 0 && b.length() > 0 && a.start() < b.end() && b.start() < a.end();
+				if (!same && !overlap)
+					continue;
+
+				const Selection first = before(selections[j].second, selections[i].second) ? selections[j].second : selections[i].second;
+				const Sci_Position start = (a.start() < b.start()) ? a.start() : b.start();
+				const Sci_Position end = (a.end() > b.end()) ? a.end() : b.end();
+				selections[i].first = (first.caret < first.anchor) ? Selection(start, end) : Selection(end, start);
+				selections[i].second = first;
+				selections.erase(selections.begin() + j);
+				merged = true;
+			}
+		}
+	}
+
+	std::vector<Selection> result;
+	for (const auto &caret : selections) {
+		bool inside = false;
+		for (const auto &selection : selections) {
+			const Selection &range = selection.first;
+			inside = inside || (caret.first.length() == 0 && range.length() > 0 && caret.first.start() >= range.start() && caret.first.start() <= range.end());
+		}
+		if (!inside)
+			result.push_back(caret.first);
+	}
+	std::sort(result.begin(), result.end(), before);
+	return result;
+}
+
+int main() {
+	std::mt19937 random(1);
+
+	// Short lines and lots of carets, so changes overlap, touch and get grouped
+	int batched = 0;
+	for (int trial = 0; trial < 20000; ++trial) {
+		const std::string text = RandomText(random, "ab_ .,(\t\r\n", 1 + random() % 120);
+		const Command command = static_cast<Command>(random() % 5);
+		const bool empty = (command == DeleteWordLeft || command == DeleteWordRight);
+		const std::vector<Selection> selections = RandomSelections(random, text, 1 + random() % 24, empty);
+		const long long editCost = (random() % 2 == 0) ? 0 : 1 << 20;
+
+		std::vector<Selection> expected = selections;
+		const std::string expectedText = EachSelection(text, expected, command);
+
+		HeadlessEditor editor(text);
+		editor.SetAllLinesVisible(random() % 4 != 0);
+		std::vector<Selection> actual = selections;
+		if (!Batch(editor, actual, command, editCost)) {
+			CHECK(editor.Text() == text);
+			continue;
+		}
+
+		++batched;
+		CHECK(editor.Text() == expectedText);
+		CheckSame(expected, actual);
+		CHECK_EQUAL(1, editor.undoActions);
+	}
+
+	// Most of them still get done in a batch
+	CHECK(batched > 10000);
+
+	// Deleting the selection before a caret joins a CR and a LF, which
+	// backspace then deletes together. Only going caret by caret knows that.
+	{
+		HeadlessEditor editor("\rab\nc");
+		std::vector<Selection> selections{ Selection(1, 3), Selection(4, 4) };
+		CHECK(!Batch(editor, selections, DeleteBack, 0));
+	}
+
+	// So does a word deleted by one caret running into the next
+	{
+		HeadlessEditor editor("abc def");
+		std::vector<Selection> selections{ Selection(0, 0), Selection(2, 2) };
+		CHECK(!Batch(editor, selections, DeleteWordRight, 0));
+	}
+
+	// A column of carets is grouped into a single replacement, unless there is
+	// an indicator or a marker in the way, or folded lines
+	std::string lines;
+	for (int line = 0; line < 100; ++line)
+		lines += "value = 1;\r\n";
+
+	std::vector<Selection> column;
+	for (Sci_Position line = 0; line < 100; ++line)
+		column.emplace_back(line * 12 + 5, line * 12 + 5);
+
+	{
+		HeadlessEditor editor(lines);
+		std::vector<Selection> selections = column;
+		Batch(editor, selections, DeleteBack, 1024);
+		CHECK_EQUAL(1, editor.replacements);
+		CHECK_EQUAL(100, selections.size());
+		CHECK_EQUAL(4, selections.front().caret);
+		CHECK_EQUAL(99 * 11 + 4, selections.back().caret);
+	}
+
+	{
+		HeadlessEditor editor(lines);
+		editor.SetIndicatorRun(50 * 12, 50 * 12 + 4);
+		std::vector<Selection> selections = column;
+		Batch(editor, selections, DeleteBack, 1024);
+		CHECK_EQUAL(100, editor.replacements);
+	}
+
+	{
+		HeadlessEditor editor(lines);
+		editor.AddMarker(50);
+		std::vector<Selection> selections = column;
+		Batch(editor, selections, DeleteBack, 1024);
+		CHECK_EQUAL(100, editor.replacements);
+	}
+
+	{
+		HeadlessEditor editor(lines);
+		editor.SetAllLinesVisible(false);
+		std::vector<Selection> selections = column;
+		Batch(editor, selections, DeleteBack, 1024);
+		CHECK_EQUAL(100, editor.replacements);
+	}
+
+	// The gap only travels across the batch, from whichever end it is nearer
+	{
+		HeadlessEditor editor(lines);
+		std::vector<Selection> selections = column;
+		Batch(editor, selections, DeleteBack, 0);
+		CHECK_EQUAL(100, editor.replacements);
+		CHECK(editor.gapMoved <= 100 * 12);
+	}
+
+	// Merging in one pass does the same as uniting them pair by pair, and
+	// merged selections are left alone by AddSelection in any order, since it
+	// trims whatever overlaps the one being added
+	for (int trial = 0; trial < 20000; ++trial) {
+		const std::string text((trial % 2 == 0) ? 20 : 200, 'a');
+		std::vector<Selection> selections = RandomSelections(random, text, random() % 30, trial % 5 == 0);
+		// Which of two facing opposite ways over the same text is kept is up to the sort
+		selections.erase(std::remove_if(selections.begin(), selections.end(), [&selections](const Selection &selection) {
+			return std::any_of(selections.cbegin(), selections.cend(), [&selection](const Selection &other) {
+				return other.caret == selection.anchor && other.anchor == selection.caret && other.caret != other.anchor;
+			});
+		}), selections.end());
+		if (trial % 3 == 0)
+			selections.insert(selections.end(), selections.cbegin(), selections.cbegin() + selections.size() / 2);
+
+		const std::vector<Selection> expected = ReferenceMerge(selections);
+		MergeSelections(selections);
+		CheckSame(expected, selections);
+
+		std::vector<Selection> again = selections;
+		MergeSelections(again);
+		CheckSame(selections, again);
+
+		if (selections.empty())
+			continue;
+
+		std::shuffle(again.begin(), again.end(), random);
+		HeadlessEditor editor(text);
+		RestoreSelections(editor, again);
+		std::vector<Selection> restored = Selections(editor);
+		SortSelections(restored);
+		CheckSame(selections, restored);
+	}
+
+	// Merged selections come back the same one at a time and with a scaffold,
+	// starting from any kind of selection
+	for (int trial = 0; trial < 5000; ++trial) {
+		std::string text;
+		for (size_t lines = 1 + random() % 40; lines > 0; --lines)
+			text += RandomText(random, "ab ", random() % 10) + ((random() % 2 == 0) ? "\r\n" : "\n");
+		std::vector<Selection> selections = RandomSelections(random, text, 1 + random() % 40, false);
+		MergeSelections(selections);
+
+		for (const bool scaffold : { false, true }) {
+			HeadlessEditor editor(text);
+			if (random() % 2 == 0) {
+				editor.SetRectangularSelectionAnchor(random() % (text.size() + 1));
+				editor.SetRectangularSelectionCaret(random() % (text.size() + 1));
+			}
+			if (random() % 2 == 0)
+				editor.SetSelectionMode(editor.GetSelectionMode());
+			const bool moveExtends = editor.GetMoveExtendsSelection();
+			const long long linesBefore = editor.linesLaidOut;
+
+			if (!scaffold) {
+				RestoreSelections(editor, selections);
+				CheckSame(selections, Selections(editor));
+				CHECK_EQUAL(selections.size() - 1, editor.GetMainSelection());
+				continue;
+			}
+
+			const bool set = SetSelectionsWithScaffold(editor, selections);
+			CHECK_EQUAL(selections.size() >= 2 && static_cast<Sci_Position>(selections.size()) <= editor.GetLineCount(), set);
+			if (set) {
+				CheckRestored(selections, editor, moveExtends);
+				CHECK(editor.linesLaidOut - linesBefore <= static_cast<long long>(selections.size()) + 1);
+			}
+		}
+	}
+
+	// Lots of them are set without any trimming and only lay out the lines
+	// they need, even far down the document
+	{
+		std::string text;
+		for (int line = 0; line < 20000; ++line)
+			text += "value = limit;\r\n";
+
+		std::vector<Selection> selections;
+		for (Sci_Position line = 10000; line < 12000; ++line)
+			selections.emplace_back(line * 16 + 2 + line % 5, line * 16 + 2);
+
+		HeadlessEditor editor(text);
+		RestoreSelections(editor, selections);
+		CheckRestored(selections, editor, false);
+		CHECK_EQUAL(0, editor.trims);
+		CHECK(editor.linesLaidOut <= 2001);
+	}
+
+	return TestResult("SelectionEditTests");
+}
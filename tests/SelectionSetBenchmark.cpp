@@ -0,0 +1,100 @@
+// This file is part of BetterMultiSelection.
+// 
+// Copyright (C)2017 Justin Dailey <dail8859@yahoo.com>
+// 
+// BetterMultiSelection is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "SelectionEdit.h"
+#include "SelectionSet.h"
+
+#include "Benchmark.h"
+
+// Sorting the selections and putting them in a SelectionSet, then moving every
+// one of them for text typed in front of them all, compared with moving them
+// as caret and anchor pairs.
+
+// Keeps the results so the work can't be optimized away
+static volatile Sci_Position sink = 0;
+
+// Every other selection is a caret, the rest go either way
+static std::vector<Selection> Spaced(size_t count) {
+	std::vector<Selection> selections;
+	for (size_t i = 0; i < count; ++i) {
+		const Sci_Position start = static_cast<Sci_Position>(10 + i * 10);
+		const Sci_Position length = (i % 2 == 0) ? 0 : 4;
+		if (i % 4 == 1)
+			selections.emplace_back(start, start + length);
+		else
+			selections.emplace_back(start + length, start);
+	}
+	return selections;
+}
+
+static void Sorting(const std::vector<Selection> &sorted) {
+	std::vector<Selection> shuffled = sorted;
+	std::shuffle(shuffled.begin(), shuffled.end(), std::mt19937(sorted.size()));
+
+	std::vector<Selection> selections;
+	const double inOrder = BestTime(3, [&]() { selections = sorted; }, [&]() { SortSelections(selections); });
+	const double anyOrder = BestTime(3, [&]() { selections = shuffled; }, [&]() { SortSelections(selections); });
+
+	SelectionSet set;
+	const double assign = BestTime(3, []() {}, [&]() { set.Assign(sorted); });
+
+	std::printf("  sort in order %8.2f ms, any order %8.2f ms, assign %8.2f ms (%s)\n", inOrder, anyOrder, assign, buildName);
+}
+
+static void Shifting(const std::vector<Selection> &sorted) {
+	SelectionSet set;
+	set.Assign(sorted);
+	const double setTime = BestTime(5, []() {}, [&]() {
+		sink += set.InsertText(5, 1);
+		sink += set.DeleteText(5, 1);
+	});
+
+	// What the plugin did before, one caret and anchor pair at a time
+	std::vector<Selection> pairs = sorted;
+	const double pairTime = BestTime(5, []() {}, [&]() {
+		for (Selection &selection : pairs)
+			selection.offset(1);
+		for (Selection &selection : pairs)
+			selection.offset(-1);
+	});
+
+	sink += set.front().caret + pairs.front().caret;
+	std::printf("  insert and delete %8.2f ms, as pairs %8.2f ms (%s)\n", setTime, pairTime, buildName);
+}
+
+int main(int argc, char *argv[]) {
+	const bool quick = IsQuickRun(argc, argv);
+
+	for (const size_t count : { 10000, 1000000, 10000000 }) {
+		if (quick && count > 10000)
+			break;
+
+		const std::vector<Selection> sorted = Spaced(count);
+		std::printf("%zu selections\n", count);
+		Sorting(sorted);
+		Shifting(sorted);
+	}
+
+	return 0;
+}
@@ -0,0 +1,119 @@
+// This file is part of BetterMultiSelection.
+// 
+// Copyright (C)2017 Justin Dailey <dail8859@yahoo.com>
+// 
+// BetterMultiSelection is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+
+#include <vector>
+
+#include "SelectionSet.h"
+
+#include "Testing.h"
+
+// Scintilla's SelectionPosition::MoveForInsertDelete() for a position that
+// isn't exactly where the text was inserted or at either end of the deletion
+static Sci_Position MoveForInsertDelete(Sci_Position position, bool insertion, Sci_Position startChange, Sci_Position length) {
+	if (insertion) {
+		if (position > startChange)
+			position += length;
+	}
+	else if (position > startChange) {
+		const Sci_Position endDeletion = startChange + length;
+		position = (position > endDeletion) ? position - length : startChange;
+	}
+	return position;
+}
+
+static bool Touches(const std::vector<Selection> &selections, Sci_Position position) {
+	for (const auto &selection : selections) {
+		if (selection.caret == position || selection.anchor == position)
+			return true;
+	}
+	return false;
+}
+
+static void CheckSame(const std::vector<Selection> &expected, const SelectionSet &set) {
+	CHECK_EQUAL(expected.size(), set.size());
+	if (expected.size() != set.size())
+		return;
+
+	for (size_t i = 0; i < expected.size(); ++i) {
+		CHECK_EQUAL(expected[i].caret, set[i].caret);
+		CHECK_EQUAL(expected[i].anchor, set[i].anchor);
+	}
+}
+
+static std::vector<Selection> RandomSelections(std::mt19937 &random, size_t count, Sci_Position length) {
+	std::uniform_int_distribution<Sci_Position> position(0, length);
+	std::vector<Selection> selections;
+	for (size_t i = 0; i < count; ++i) {
+		const Sci_Position caret = position(random);
+		selections.emplace_back(caret, (random() % 2 == 0) ? caret : position(random));
+	}
+	return selections;
+}
+
+int main() {
+	std::mt19937 random(14);
+
+	// Sizes either side of the number of lanes so the leftovers after the
+	// vector loop get checked too
+	for (int trial = 0; trial < 20000; ++trial) {
+		const size_t count = random() % 12;
+		const Sci_Position length = 1 + random() % 200;
+		std::vector<Selection> selections = RandomSelections(random, count, length);
+
+		SelectionSet set;
+		set.Assign(selections);
+		CheckSame(selections, set);
+
+		std::vector<Selection> copied;
+		set.CopyTo(copied);
+		CheckSame(copied, set);
+
+		std::uniform_int_distribution<Sci_Position> position(0, length);
+		const bool insertion = random() % 2 == 0;
+		const Sci_Position startChange = position(random);
+		const Sci_Position changeLength = 1 + random() % 20;
+
+		const bool ambiguous = insertion ? Touches(selections, startChange) : (Touches(selections, startChange) || Touches(selections, startChange + changeLength));
+		const bool moved = insertion ? set.InsertText(startChange, changeLength) : set.DeleteText(startChange, changeLength);
+		CHECK_EQUAL(!ambiguous, moved);
+
+		if (moved) {
+			for (auto &selection : selections) {
+				selection.caret = MoveForInsertDelete(selection.caret, insertion, startChange, changeLength);
+				selection.anchor = MoveForInsertDelete(selection.anchor, insertion, startChange, changeLength);
+			}
+		}
+		CheckSame(selections, set);
+	}
+
+	// Lots of carets on consecutive lines, as the plugin usually has
+	std::vector<Selection> column;
+	for (Sci_Position line = 0; line < 1000; ++line)
+		column.emplace_back(line * 10 + 3, line * 10 + 3);
+
+	SelectionSet set;
+	set.Assign(column);
+	CHECK(set.InsertText(0, 5));
+	CHECK(set.DeleteText(4000, 100));
+	CHECK(!set.InsertText(3 + 5, 1));
+	CHECK_EQUAL(8, set.front().caret);
+	CHECK_EQUAL(9898, set.back().caret);
+
+	return TestResult("SelectionSetTests");
+}
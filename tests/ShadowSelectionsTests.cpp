@@ -0,0 +1,147 @@
+// This file is part of BetterMultiSelection.
+// 
+// Copyright (C)2017 Justin Dailey <dail8859@yahoo.com>
+// 
+// BetterMultiSelection is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include "SelectionEdit.h"
+#include "ShadowSelections.h"
+
+#include "HeadlessEditor.h"
+#include "Testing.h"
+
+static void SetSelections(HeadlessEditor &editor, ShadowSelections &shadow, const std::vector<Selection> &selections) {
+	RestoreSelections(editor, selections);
+	shadow.Set(selections);
+}
+
+// Passes on the text changes the way beNotified does
+static void Replay(HeadlessEditor &editor, ShadowSelections &shadow) {
+	for (const auto &modification : editor.modifications) {
+		if (modification.type & (SC_MOD_INSERTTEXT | SC_MOD_DELETETEXT))
+			shadow.Update((modification.type & SC_MOD_INSERTTEXT) != 0, modification.position, modification.length);
+	}
+	editor.modifications.clear();
+}
+
+int main() {
+	std::mt19937 random(12);
+
+	std::string text;
+	for (int line = 0; line < 1000; ++line)
+		text += "value = limit;\r\n";
+
+	std::vector<Selection> column;
+	for (Sci_Position line = 0; line < 1000; ++line)
+		column.emplace_back(line * 16 + 8, line * 16 + ((line % 2 == 0) ? 8 : 13));
+
+	HeadlessEditor editor(text);
+	ShadowSelections shadow;
+	CHECK(!shadow.Matches(editor));
+
+	SetSelections(editor, shadow, column);
+	CHECK(shadow.Matches(editor));
+	CHECK(shadow.Equals(editor));
+
+	std::vector<Selection> copied;
+	shadow.CopyTo(copied);
+	CHECK_EQUAL(column.size(), copied.size());
+
+	shadow.Invalidate();
+	CHECK(!shadow.Matches(editor));
+
+	// A selection more or less is always noticed
+	SetSelections(editor, shadow, column);
+	editor.AddSelection(5, 5);
+	CHECK(!shadow.Matches(editor));
+
+	SetSelections(editor, shadow, std::vector<Selection>(column.cbegin(), column.cend() - 1));
+	editor.AddSelection(column.back().caret, column.back().anchor);
+	CHECK(!shadow.Matches(editor));
+
+	// So is any change to the main selection or one of the sampled ones. Each
+	// selection is moved within its line so they stay in order.
+	const size_t last = column.size() - 1;
+	std::vector<size_t> checked{ static_cast<size_t>(editor.GetMainSelection()) };
+	for (size_t sample = 0; sample <= ShadowSelections::samples + 1; ++sample)
+		checked.push_back(last * sample / (ShadowSelections::samples + 1));
+	for (size_t n : checked) {
+		SetSelections(editor, shadow, column);
+		editor.SetSelectionNCaret(static_cast<int>(n), column[n].caret + 1);
+		CHECK(!shadow.Matches(editor));
+		CHECK(!shadow.Equals(editor));
+
+		SetSelections(editor, shadow, column);
+		editor.SetSelectionNAnchor(static_cast<int>(n), column[n].anchor - 1);
+		CHECK(!shadow.Matches(editor));
+	}
+
+	// Anything in between can only be caught by comparing every selection
+	SetSelections(editor, shadow, column);
+	editor.SetSelectionNCaret(static_cast<int>(last / (ShadowSelections::samples + 1) / 2), 2);
+	CHECK(shadow.Matches(editor));
+	CHECK(!shadow.Equals(editor));
+
+	// Which is why text changed by anyone else has to be passed on. Here text
+	// of the same length replaces a middle selection, e.g. from the other view.
+	editor.recordModifications = true;
+	const Selection middle = column[column.size() / 2 + 1];
+	SetSelections(editor, shadow, column);
+	editor.SetTargetRange(middle.start() - 2, middle.end() + 2);
+	editor.ReplaceTarget(middle.length() + 4, std::string(middle.length() + 4, 'x').c_str());
+	CHECK(shadow.Matches(editor));
+	CHECK(!shadow.Equals(editor));
+	Replay(editor, shadow);
+	CHECK(!shadow.Matches(editor));
+
+	// Otherwise the shadow either follows the selections exactly, or gives up
+	// when it can't tell where Scintilla puts them
+	int followed = 0;
+	for (int trial = 0; trial < 2000; ++trial) {
+		editor.SetText(text);
+		editor.modifications.clear();
+		SetSelections(editor, shadow, column);
+
+		for (int edit = 0; edit < 5; ++edit) {
+			const Sci_Position length = editor.GetLength();
+			const Sci_Position start = random() % length;
+			const Sci_Position end = start + random() % ((trial % 2 == 0) ? 3 : 40);
+			const std::string inserted = RandomText(random, "ab\r\n", random() % 4);
+			editor.SetTargetRange(start, (end < length) ? end : length);
+			editor.ReplaceTarget(static_cast<Sci_Position>(inserted.size()), inserted.c_str());
+			Replay(editor, shadow);
+		}
+
+		if (shadow.Valid()) {
+			++followed;
+			CHECK(shadow.Equals(editor));
+			CHECK(shadow.Matches(editor));
+		}
+		else {
+			CHECK(!shadow.Matches(editor));
+		}
+	}
+	// Both happen often enough to have been checked
+	CHECK(followed > 200);
+	CHECK(followed < 2000);
+
+	return TestResult("ShadowSelectionsTests");
+}
@@ -0,0 +1,64 @@
+// This file is part of BetterMultiSelection.
+// 
+// Copyright (C)2017 Justin Dailey <dail8859@yahoo.com>
+// 
+// BetterMultiSelection is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+
+#pragma once
+
+#include <cstdio>
+#include <random>
+#include <string>
+
+// Just enough to write checks without a test framework. Each test program
+// exits with a failure if any check failed, so ctest reports it.
+
+static int failures = 0;
+
+#define CHECK(condition) \
+	do { \
+		if (!(condition)) { \
+			++failures; \
+			if (failures <= 20) \
+				std::printf("%s:%d: failed: %s\n", __FILE__, __LINE__, #condition); \
+		} \
+	} while (0)
+
+#define CHECK_EQUAL(expected, actual) \
+	do { \
+		const long long expectedValue = static_cast<long long>(expected); \
+		const long long actualValue = static_cast<long long>(actual); \
+		if (expectedValue != actualValue) { \
+			++failures; \
+			if (failures <= 20) \
+				std::printf("%s:%d: failed: %s is %lld, expected %lld\n", __FILE__, __LINE__, #actual, actualValue, expectedValue); \
+		} \
+	} while (0)
+
+inline int TestResult(const char *name) {
+	std::printf("%s: %d failed\n", name, failures);
+	return failures == 0 ? 0 : 1;
+}
+
+// Random text made from the given characters, always the same for a seed so
+// failures can be reproduced
+inline std::string RandomText(std::mt19937 &random, const std::string &alphabet, size_t length) {
+	std::uniform_int_distribution<size_t> pick(0, alphabet.size() - 1);
+	std::string text;
+	for (size_t i = 0; i < length; ++i)
+		text += alphabet[pick(random)];
+	return text;
+}
@@ -0,0 +1,154 @@
+// This file is part of BetterMultiSelection.
+// 
+// Copyright (C)2017 Justin Dailey <dail8859@yahoo.com>
+// 
+// BetterMultiSelection is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+
+#include <string>
+#include <vector>
+
+#include "TextConversion.h"
+#include "UniConversion.h"
+
+#include "Testing.h"
+
+// How pasted text was split into lines before SplitLines() existed: line ends
+// were converted to eol in a copy of the text, which was then split at each eol
+// leaving out empty lines.
+static std::string TransformLineEnds(const std::string &s, const std::string &eol) {
+	std::string dest;
+	for (size_t i = 0; i < s.size(); i++) {
+		if (s[i] == '\n' || s[i] == '\r') {
+			dest += eol;
+			if (s[i] == '\r' && i + 1 < s.size() && s[i + 1] == '\n')
+				i++;
+		}
+		else {
+			dest.push_back(s[i]);
+		}
+	}
+	return dest;
+}
+
+static std::vector<std::string> Split(const std::string &str, const std::string &delim) {
+	size_t start;
+	size_t end = 0;
+	std::vector<std::string> out;
+	while ((start = str.find_first_not_of(delim, end)) != std::string::npos) {
+		end = str.find(delim, start);
+		out.push_back(str.substr(start, end - start));
+	}
+	return out;
+}
+
+static std::vector<std::string> ReferenceLines(const std::string &text, bool convertLineEnds, const std::string &eol) {
+	return Split(convertLineEnds ? TransformLineEnds(text, eol) : text, eol);
+}
+
+static void CheckLines(const std::vector<std::string> &expected, const std::vector<TextLine> &lines) {
+	CHECK_EQUAL(expected.size(), lines.size());
+	for (size_t i = 0; i < expected.size() && i < lines.size(); ++i)
+		CHECK(expected[i] == std::string(lines[i].text, lines[i].length));
+}
+
+static void CheckUTF16FromUTF8(const std::string &text) {
+	const size_t expectedLength = UTF16Length(text.data(), text.size());
+	CHECK_EQUAL(expectedLength, UTF16LengthOfUTF8(text.data(), text.size()));
+
+	std::vector<wchar_t> expected(expectedLength + 1);
+	UTF16FromUTF8(text.data(), text.size(), expected.data(), expected.size());
+
+	// Converted after a prefix to check appending, with room to spare after it
+	std::vector<wchar_t> actual(expectedLength + 16, L'?');
+	actual[0] = L'x';
+	const wchar_t *end = AppendUTF16FromUTF8(text.data(), text.size(), actual.data() + 1);
+	CHECK_EQUAL(expectedLength + 1, end - actual.data());
+	CHECK(actual[0] == L'x');
+	for (size_t i = 0; i < expectedLength; ++i)
+		CHECK_EQUAL(expected[i], actual[i + 1]);
+	CHECK(actual[expectedLength + 1] == L'?');
+}
+
+static void CheckUTF8LinesFromUTF16(const std::vector<wchar_t> &text, bool convertLineEnds, const std::string &eol) {
+	// Only up to the first NUL gets converted
+	size_t tlen = 0;
+	while (tlen < text.size() && text[tlen] != 0)
+		tlen++;
+
+	// UTF8FromUTF16() reads the unit after a lone lead surrogate at the end,
+	// which for clipboard text is always the terminating NUL
+	std::vector<wchar_t> terminated(text.begin(), text.begin() + tlen);
+	terminated.push_back(0);
+
+	const size_t length = UTF8Length(terminated.data(), tlen);
+	std::string utf8(length + 1, '\0');
+	UTF8FromUTF16(terminated.data(), tlen, &utf8[0], length + 1);
+	utf8.resize(length);
+
+	std::string buffer;
+	std::vector<TextLine> lines;
+	UTF8LinesFromUTF16(text.data(), text.size(), convertLineEnds, eol.c_str(), buffer, lines);
+	CheckLines(ReferenceLines(utf8, convertLineEnds, eol), lines);
+}
+
+int main() {
+	std::mt19937 random(21);
+
+	// Long ASCII runs get converted 16 at a time so they're mixed with
+	// multi-byte and invalid UTF-8 at every offset
+	const std::string ascii = "abc \t";
+	const std::string others[] = { "\r", "\n", "\r\n", "\xC3\xA9", "\xE2\x82\xAC", "\xF0\x9F\x98\x80", "\x80", "\xE2\x82", "\xFF" };
+	const std::string eols[] = { "\r\n", "\r", "\n" };
+
+	for (int trial = 0; trial < 5000; ++trial) {
+		std::string text;
+		const size_t pieces = random() % 8;
+		for (size_t i = 0; i < pieces; ++i) {
+			text += RandomText(random, ascii, random() % 40);
+			text += others[random() % (sizeof(others) / sizeof(others[0]))];
+		}
+
+		CheckUTF16FromUTF8(text);
+
+		for (const std::string &eol : eols) {
+			for (const bool convertLineEnds : { false, true }) {
+				std::vector<TextLine> lines;
+				SplitLines(text.data(), text.size(), convertLineEnds, eol.c_str(), lines);
+				CheckLines(ReferenceLines(text, convertLineEnds, eol), lines);
+			}
+		}
+	}
+
+	// UTF-16 with runs of ASCII, line ends, characters of every UTF-8 length,
+	// surrogate pairs, lone surrogates and the odd NUL
+	const wchar_t units[] = { L'a', L' ', L'\t', L'\r', L'\n', 0xE9, 0x20AC, 0xD83D, 0xDE00, 0 };
+	for (int trial = 0; trial < 5000; ++trial) {
+		std::vector<wchar_t> text;
+		const size_t pieces = random() % 8;
+		for (size_t i = 0; i < pieces; ++i) {
+			text.insert(text.end(), random() % 20, L'a' + static_cast<wchar_t>(random() % 3));
+			const size_t count = (trial % 5 == 0) ? sizeof(units) / sizeof(units[0]) : sizeof(units) / sizeof(units[0]) - 1;
+			text.push_back(units[random() % count]);
+		}
+
+		for (const std::string &eol : eols) {
+			CheckUTF8LinesFromUTF16(text, false, eol);
+			CheckUTF8LinesFromUTF16(text, true, eol);
+		}
+	}
+
+	return TestResult("TextConversionTests");
+}